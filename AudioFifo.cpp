@@ -0,0 +1,96 @@
+#include "AudioFifo.h"
+#include <algorithm>
+#include <cstring>
+
+// Constructor
+AudioFifo::AudioFifo()
+    : mNumChannels(0),
+      mCapacity(0),
+      mMask(0),
+      mReadPosition(0),
+      mWritePosition(0)
+{
+}
+
+// Allocate storage, rounding the capacity up to a power of two
+void AudioFifo::Allocate(uint32_t inNumChannels, uint32_t inMinCapacity) {
+    uint32_t capacity = 1;
+    while (capacity < inMinCapacity) {
+        capacity <<= 1;
+    }
+
+    mNumChannels = inNumChannels;
+    mCapacity = capacity;
+    mMask = capacity - 1;
+    mStorage.assign(static_cast<size_t>(inNumChannels) * capacity, 0.0f);
+    Clear();
+}
+
+void AudioFifo::Clear() {
+    mReadPosition.store(0, std::memory_order_relaxed);
+    mWritePosition.store(0, std::memory_order_release);
+}
+
+uint32_t AudioFifo::GetReadAvailable() const {
+    return static_cast<uint32_t>(mWritePosition.load(std::memory_order_acquire) -
+                                 mReadPosition.load(std::memory_order_relaxed));
+}
+
+uint32_t AudioFifo::GetWriteAvailable() const {
+    return mCapacity - static_cast<uint32_t>(mWritePosition.load(std::memory_order_relaxed) -
+                                             mReadPosition.load(std::memory_order_acquire));
+}
+
+uint32_t AudioFifo::Write(const float* const* inData, uint32_t inFrames) {
+    const uint32_t frames = std::min(inFrames, GetWriteAvailable());
+    const uint64_t position = mWritePosition.load(std::memory_order_relaxed);
+    const uint32_t start = static_cast<uint32_t>(position) & mMask;
+    const uint32_t first = std::min(frames, mCapacity - start);
+
+    for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+        float* storage = mStorage.data() + static_cast<size_t>(channel) * mCapacity;
+        memcpy(storage + start, inData[channel], first * sizeof(float));
+        memcpy(storage, inData[channel] + first, (frames - first) * sizeof(float));
+    }
+
+    mWritePosition.store(position + frames, std::memory_order_release);
+    return frames;
+}
+
+uint32_t AudioFifo::WriteSilence(uint32_t inFrames) {
+    const uint32_t frames = std::min(inFrames, GetWriteAvailable());
+    const uint64_t position = mWritePosition.load(std::memory_order_relaxed);
+    const uint32_t start = static_cast<uint32_t>(position) & mMask;
+    const uint32_t first = std::min(frames, mCapacity - start);
+
+    for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+        float* storage = mStorage.data() + static_cast<size_t>(channel) * mCapacity;
+        std::fill_n(storage + start, first, 0.0f);
+        std::fill_n(storage, frames - first, 0.0f);
+    }
+
+    mWritePosition.store(position + frames, std::memory_order_release);
+    return frames;
+}
+
+uint32_t AudioFifo::Read(float* const* outData, uint32_t inFrames) {
+    const uint32_t frames = std::min(inFrames, GetReadAvailable());
+    const uint64_t position = mReadPosition.load(std::memory_order_relaxed);
+    const uint32_t start = static_cast<uint32_t>(position) & mMask;
+    const uint32_t first = std::min(frames, mCapacity - start);
+
+    for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+        const float* storage = mStorage.data() + static_cast<size_t>(channel) * mCapacity;
+        memcpy(outData[channel], storage + start, first * sizeof(float));
+        memcpy(outData[channel] + first, storage, (frames - first) * sizeof(float));
+    }
+
+    mReadPosition.store(position + frames, std::memory_order_release);
+    return frames;
+}
+
+uint32_t AudioFifo::Discard(uint32_t inFrames) {
+    const uint32_t frames = std::min(inFrames, GetReadAvailable());
+    mReadPosition.store(mReadPosition.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+    return frames;
+}
@@ -0,0 +1,43 @@
+// Standard library headers
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Include guards
+#ifndef __AudioFifo_h__
+#define __AudioFifo_h__
+
+// Multichannel single-producer/single-consumer ring buffer of non-interleaved
+// floats. Storage is allocated once in Allocate(); Write() and Read() never
+// allocate or block, so either end may run on the render thread.
+class AudioFifo
+{
+public:
+    AudioFifo();
+
+    // Not thread safe: call while neither end is running
+    void Allocate(uint32_t inNumChannels, uint32_t inMinCapacity);
+    void Clear();
+
+    uint32_t GetCapacity() const { return mCapacity; }
+    uint32_t GetReadAvailable() const;
+    uint32_t GetWriteAvailable() const;
+
+    // Both return the number of frames actually transferred
+    uint32_t Write(const float* const* inData, uint32_t inFrames);
+    uint32_t WriteSilence(uint32_t inFrames);
+    uint32_t Read(float* const* outData, uint32_t inFrames);
+    uint32_t Discard(uint32_t inFrames);
+
+private:
+    std::vector<float> mStorage;
+    uint32_t mNumChannels;
+    uint32_t mCapacity;
+    uint32_t mMask;
+
+    // Monotonic frame counters; the difference is the fill level
+    std::atomic<uint64_t> mReadPosition;
+    std::atomic<uint64_t> mWritePosition;
+};
+
+#endif /* __AudioFifo_h__ */
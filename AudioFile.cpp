@@ -0,0 +1,434 @@
+#include "AudioFile.h"
+#include "AudioKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint16_t kWaveFormatPCM = 0x0001;
+const uint16_t kWaveFormatFloat = 0x0003;
+const uint16_t kWaveFormatExtensible = 0xFFFE;
+
+// Frames interleaved per write
+const uint32_t kWriteFrames = 4096;
+
+// WAV data is capped by its 32-bit sizes
+const uint64_t kMaxWavDataBytes = 0xFFFFFFFFull - 36;
+
+uint16_t ReadLE16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadLE32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint16_t ReadBE16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+uint32_t ReadBE32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+// AIFF stores its rate as an 80-bit IEEE extended float
+double ReadExtended(const uint8_t* p) {
+    const int exponent = ((p[0] & 0x7F) << 8) | p[1];
+    uint64_t mantissa = 0;
+    for (int i = 0; i < 8; ++i) {
+        mantissa = (mantissa << 8) | p[2 + i];
+    }
+    const double value = ldexp(static_cast<double>(mantissa), exponent - 16383 - 63);
+    return (p[0] & 0x80) ? -value : value;
+}
+
+void WriteLE16(FILE* file, uint16_t value) {
+    const uint8_t bytes[2] = { static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8) };
+    fwrite(bytes, 1, 2, file);
+}
+
+void WriteLE32(FILE* file, uint32_t value) {
+    const uint8_t bytes[4] = {
+        static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+        static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24)
+    };
+    fwrite(bytes, 1, 4, file);
+}
+
+// Decodes one channel with the sample reader inRead, frames inStride bytes
+// apart
+template <typename Reader>
+void DecodeChannel(const uint8_t* inSamples, size_t inStride, float* outChannel, uint32_t inFrames, Reader inRead) {
+    for (uint32_t i = 0; i < inFrames; ++i) {
+        outChannel[i] = inRead(inSamples + i * inStride);
+    }
+}
+
+} // namespace
+
+// Constructor
+MappedAudioFile::MappedAudioFile()
+    : mData(nullptr),
+      mSize(0),
+      mSamples(nullptr),
+      mEncoding(kEncoding_Int16),
+      mBigEndian(false),
+      mBytesPerSample(0),
+      mSampleRate(0.0),
+      mNumChannels(0),
+      mNumFrames(0)
+{
+}
+
+// Destructor
+MappedAudioFile::~MappedAudioFile() {
+    Close();
+}
+
+bool MappedAudioFile::Open(const std::string& inPath, std::string& outError) {
+    Close();
+
+    const int fd = open(inPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        outError = "cannot open " + inPath;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < 12) {
+        close(fd);
+        outError = inPath + " is not an audio file";
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        outError = "cannot map " + inPath;
+        return false;
+    }
+    mData = static_cast<const uint8_t*>(data);
+    mSize = static_cast<size_t>(info.st_size);
+
+    // Frames are read front to back, mostly once
+    madvise(data, mSize, MADV_SEQUENTIAL);
+
+    bool ok = false;
+    if (memcmp(mData, "RIFF", 4) == 0 && memcmp(mData + 8, "WAVE", 4) == 0) {
+        ok = ParseWav(outError);
+    } else if (memcmp(mData, "FORM", 4) == 0 && (memcmp(mData + 8, "AIFF", 4) == 0 || memcmp(mData + 8, "AIFC", 4) == 0)) {
+        ok = ParseAiff(outError);
+    } else {
+        outError = "not a WAV or AIFF file";
+    }
+    if (!ok) {
+        outError = inPath + ": " + outError;
+        Close();
+    }
+    return ok;
+}
+
+void MappedAudioFile::Close() {
+    if (mData) {
+        munmap(const_cast<uint8_t*>(mData), mSize);
+    }
+    mData = nullptr;
+    mSize = 0;
+    mSamples = nullptr;
+    mNumFrames = 0;
+}
+
+// Walk the RIFF chunks; chunks are word aligned
+bool MappedAudioFile::ParseWav(std::string& outError) {
+    uint16_t format = 0;
+    uint16_t bitsPerSample = 0;
+    size_t sampleBytes = 0;
+
+    size_t offset = 12;
+    while (offset + 8 <= mSize) {
+        const uint8_t* header = mData + offset;
+        const size_t size = ReadLE32(header + 4);
+        const uint8_t* body = header + 8;
+        const size_t bodySize = std::min(size, mSize - offset - 8);
+
+        if (memcmp(header, "fmt ", 4) == 0 && bodySize >= 16) {
+            format = ReadLE16(body);
+            mNumChannels = ReadLE16(body + 2);
+            mSampleRate = ReadLE32(body + 4);
+            bitsPerSample = ReadLE16(body + 14);
+            if (format == kWaveFormatExtensible && bodySize >= 26) {
+                format = ReadLE16(body + 24);
+            }
+        } else if (memcmp(header, "data", 4) == 0) {
+            mSamples = body;
+            sampleBytes = bodySize;
+        }
+
+        offset += 8 + size + (size & 1);
+    }
+
+    if (format == kWaveFormatPCM && bitsPerSample == 16) {
+        mEncoding = kEncoding_Int16;
+    } else if (format == kWaveFormatPCM && bitsPerSample == 24) {
+        mEncoding = kEncoding_Int24;
+    } else if (format == kWaveFormatPCM && bitsPerSample == 32) {
+        mEncoding = kEncoding_Int32;
+    } else if (format == kWaveFormatFloat && bitsPerSample == 32) {
+        mEncoding = kEncoding_Float32;
+    } else {
+        outError = "unsupported sample format";
+        return false;
+    }
+    if (mNumChannels == 0 || mSampleRate <= 0.0) {
+        outError = "unsupported sample format";
+        return false;
+    }
+    if (!mSamples) {
+        outError = "missing data chunk";
+        return false;
+    }
+
+    mBigEndian = false;
+    mBytesPerSample = bitsPerSample / 8;
+    mNumFrames = sampleBytes / (static_cast<size_t>(mBytesPerSample) * mNumChannels);
+    return true;
+}
+
+// Walk the IFF chunks: COMM has the format, SSND the samples
+bool MappedAudioFile::ParseAiff(std::string& outError) {
+    const bool compressed = memcmp(mData + 8, "AIFC", 4) == 0;
+    uint16_t bitsPerSample = 0;
+    uint32_t numFrames = 0;
+    char compression[4] = { 'N', 'O', 'N', 'E' };
+    size_t sampleBytes = 0;
+
+    size_t offset = 12;
+    while (offset + 8 <= mSize) {
+        const uint8_t* header = mData + offset;
+        const size_t size = ReadBE32(header + 4);
+        const uint8_t* body = header + 8;
+        const size_t bodySize = std::min(size, mSize - offset - 8);
+
+        if (memcmp(header, "COMM", 4) == 0 && bodySize >= 18) {
+            mNumChannels = ReadBE16(body);
+            numFrames = ReadBE32(body + 2);
+            bitsPerSample = ReadBE16(body + 6);
+            mSampleRate = ReadExtended(body + 8);
+            if (compressed && bodySize >= 22) {
+                memcpy(compression, body + 18, 4);
+            }
+        } else if (memcmp(header, "SSND", 4) == 0 && bodySize >= 8) {
+            const size_t dataOffset = ReadBE32(body);
+            if (8 + dataOffset <= bodySize) {
+                mSamples = body + 8 + dataOffset;
+                sampleBytes = bodySize - 8 - dataOffset;
+            }
+        }
+
+        offset += 8 + size + (size & 1);
+    }
+
+    mBigEndian = true;
+    if (memcmp(compression, "sowt", 4) == 0) {
+        mBigEndian = false;
+    } else if (memcmp(compression, "fl32", 4) == 0 || memcmp(compression, "FL32", 4) == 0) {
+        bitsPerSample = 32;
+    } else if (memcmp(compression, "NONE", 4) != 0) {
+        outError = "unsupported AIFC compression";
+        return false;
+    }
+
+    const bool isFloat = memcmp(compression, "fl32", 4) == 0 || memcmp(compression, "FL32", 4) == 0;
+    if (isFloat) {
+        mEncoding = kEncoding_Float32;
+    } else if (bitsPerSample == 16) {
+        mEncoding = kEncoding_Int16;
+    } else if (bitsPerSample == 24) {
+        mEncoding = kEncoding_Int24;
+    } else if (bitsPerSample == 32) {
+        mEncoding = kEncoding_Int32;
+    } else {
+        outError = "unsupported sample format";
+        return false;
+    }
+    if (mNumChannels == 0 || mSampleRate <= 0.0) {
+        outError = "unsupported sample format";
+        return false;
+    }
+    if (!mSamples) {
+        outError = "missing SSND chunk";
+        return false;
+    }
+
+    mBytesPerSample = bitsPerSample / 8;
+    mNumFrames = std::min<uint64_t>(numFrames, sampleBytes / (static_cast<size_t>(mBytesPerSample) * mNumChannels));
+    return true;
+}
+
+// Decode straight from the mapping, one channel at a time
+void MappedAudioFile::Read(float* const* outChannels, uint64_t inFirstFrame, uint32_t inFrames) const {
+    const uint32_t frames = (inFirstFrame < mNumFrames) ?
+        static_cast<uint32_t>(std::min<uint64_t>(inFrames, mNumFrames - inFirstFrame)) : 0;
+    const size_t stride = static_cast<size_t>(mBytesPerSample) * mNumChannels;
+
+    for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+        const uint8_t* samples = mSamples + inFirstFrame * stride + channel * mBytesPerSample;
+        float* output = outChannels[channel];
+
+        switch (mEncoding) {
+            case kEncoding_Int16:
+                if (mBigEndian) {
+                    DecodeChannel(samples, stride, output, frames, [](const uint8_t* p) {
+                        return static_cast<int16_t>(ReadBE16(p)) / 32768.0f;
+                    });
+                } else {
+                    DecodeChannel(samples, stride, output, frames, [](const uint8_t* p) {
+                        return static_cast<int16_t>(ReadLE16(p)) / 32768.0f;
+                    });
+                }
+                break;
+
+            case kEncoding_Int24:
+                if (mBigEndian) {
+                    DecodeChannel(samples, stride, output, frames, [](const uint8_t* p) {
+                        const uint32_t bits = (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8);
+                        return (static_cast<int32_t>(bits) >> 8) / 8388608.0f;
+                    });
+                } else {
+                    DecodeChannel(samples, stride, output, frames, [](const uint8_t* p) {
+                        const uint32_t bits = (static_cast<uint32_t>(p[2]) << 24) | (p[1] << 16) | (p[0] << 8);
+                        return (static_cast<int32_t>(bits) >> 8) / 8388608.0f;
+                    });
+                }
+                break;
+
+            case kEncoding_Int32:
+                if (mBigEndian) {
+                    DecodeChannel(samples, stride, output, frames, [](const uint8_t* p) {
+                        return static_cast<int32_t>(ReadBE32(p)) / 2147483648.0f;
+                    });
+                } else {
+                    DecodeChannel(samples, stride, output, frames, [](const uint8_t* p) {
+                        return static_cast<int32_t>(ReadLE32(p)) / 2147483648.0f;
+                    });
+                }
+                break;
+
+            case kEncoding_Float32:
+                DecodeChannel(samples, stride, output, frames, [bigEndian = mBigEndian](const uint8_t* p) {
+                    const uint32_t bits = bigEndian ? ReadBE32(p) : ReadLE32(p);
+                    float value;
+                    memcpy(&value, &bits, sizeof(value));
+                    return value;
+                });
+                GetAudioKernels().FlushDenormals(output, frames);
+                break;
+        }
+
+        std::fill_n(output + frames, inFrames - frames, 0.0f);
+    }
+}
+
+// Constructor
+WavFileWriter::WavFileWriter()
+    : mFile(nullptr),
+      mNumChannels(0),
+      mDataBytes(0)
+{
+}
+
+// Destructor
+WavFileWriter::~WavFileWriter() {
+    std::string error;
+    Close(error);
+}
+
+bool WavFileWriter::Open(const std::string& inPath, double inSampleRate, uint32_t inNumChannels,
+                         std::string& outError) {
+    mFile = fopen(inPath.c_str(), "wb");
+    if (!mFile) {
+        outError = "cannot create " + inPath;
+        return false;
+    }
+    mPath = inPath;
+    mNumChannels = inNumChannels;
+    mDataBytes = 0;
+    mChannelPtrs.assign(inNumChannels, nullptr);
+    mInterleaved.assign(static_cast<size_t>(kWriteFrames) * inNumChannels, 0.0f);
+
+    // Sizes are written as zero and patched by Close()
+    const uint32_t bytesPerFrame = inNumChannels * sizeof(float);
+    fwrite("RIFF", 1, 4, mFile);
+    WriteLE32(mFile, 0);
+    fwrite("WAVE", 1, 4, mFile);
+
+    fwrite("fmt ", 1, 4, mFile);
+    WriteLE32(mFile, 16);
+    WriteLE16(mFile, kWaveFormatFloat);
+    WriteLE16(mFile, static_cast<uint16_t>(inNumChannels));
+    WriteLE32(mFile, static_cast<uint32_t>(inSampleRate));
+    WriteLE32(mFile, static_cast<uint32_t>(inSampleRate) * bytesPerFrame);
+    WriteLE16(mFile, static_cast<uint16_t>(bytesPerFrame));
+    WriteLE16(mFile, 32);
+
+    fwrite("data", 1, 4, mFile);
+    WriteLE32(mFile, 0);
+
+    if (ferror(mFile)) {
+        outError = "write error on " + mPath;
+        return false;
+    }
+    return true;
+}
+
+bool WavFileWriter::Write(const float* const* inChannels, uint32_t inFrames, std::string& outError) {
+    const uint64_t bytes = static_cast<uint64_t>(inFrames) * mNumChannels * sizeof(float);
+    if (mDataBytes + bytes > kMaxWavDataBytes) {
+        outError = mPath + ": output exceeds the 4 GB WAV limit";
+        return false;
+    }
+
+    const AudioKernels& kernels = GetAudioKernels();
+    for (uint32_t done = 0; done < inFrames; ) {
+        const uint32_t frames = std::min(inFrames - done, kWriteFrames);
+        for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+            mChannelPtrs[channel] = inChannels[channel] + done;
+        }
+        kernels.Interleave(mChannelPtrs.data(), mInterleaved.data(), mNumChannels, frames);
+        fwrite(mInterleaved.data(), sizeof(float), static_cast<size_t>(frames) * mNumChannels, mFile);
+        done += frames;
+    }
+    mDataBytes += bytes;
+
+    if (ferror(mFile)) {
+        outError = "write error on " + mPath;
+        return false;
+    }
+    return true;
+}
+
+bool WavFileWriter::Close(std::string& outError) {
+    if (!mFile) {
+        return true;
+    }
+
+    fseek(mFile, 4, SEEK_SET);
+    WriteLE32(mFile, static_cast<uint32_t>(36 + mDataBytes));
+    fseek(mFile, 40, SEEK_SET);
+    WriteLE32(mFile, static_cast<uint32_t>(mDataBytes));
+
+    const bool ok = ferror(mFile) == 0;
+    if (fclose(mFile) != 0 || !ok) {
+        outError = "write error on " + mPath;
+        mFile = nullptr;
+        return false;
+    }
+    mFile = nullptr;
+    return true;
+}
@@ -0,0 +1,89 @@
+// Standard library headers
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Include guards
+#ifndef __AudioFile_h__
+#define __AudioFile_h__
+
+// Read-only memory map of a WAV or AIFF/AIFC file. Open() parses the header
+// and maps the file; Read() decodes any range of frames straight from the
+// mapping into non-interleaved floats, so a whole file never has to be held
+// in memory and the page cache does the buffering.
+//
+// Reads 16/24/32-bit PCM and 32-bit float: WAV (plain or
+// WAVE_FORMAT_EXTENSIBLE), AIFF, and AIFC with NONE, sowt or fl32 data.
+class MappedAudioFile
+{
+public:
+    MappedAudioFile();
+    ~MappedAudioFile();
+
+    MappedAudioFile(const MappedAudioFile&) = delete;
+    MappedAudioFile& operator=(const MappedAudioFile&) = delete;
+
+    bool Open(const std::string& inPath, std::string& outError);
+    void Close();
+
+    double GetSampleRate() const { return mSampleRate; }
+    uint32_t GetNumChannels() const { return mNumChannels; }
+    uint64_t GetNumFrames() const { return mNumFrames; }
+
+    // Decodes frames [inFirstFrame, inFirstFrame + inFrames) into
+    // GetNumChannels() buffers; frames past the end read as silence
+    void Read(float* const* outChannels, uint64_t inFirstFrame, uint32_t inFrames) const;
+
+private:
+    enum Encoding {
+        kEncoding_Int16,
+        kEncoding_Int24,
+        kEncoding_Int32,
+        kEncoding_Float32
+    };
+
+    bool ParseWav(std::string& outError);
+    bool ParseAiff(std::string& outError);
+
+    // The mapping
+    const uint8_t* mData;
+    size_t mSize;
+
+    // Sample layout
+    const uint8_t* mSamples;
+    Encoding mEncoding;
+    bool mBigEndian;
+    uint32_t mBytesPerSample;
+    double mSampleRate;
+    uint32_t mNumChannels;
+    uint64_t mNumFrames;
+};
+
+// Streams 32-bit float WAV output block by block. The RIFF and data sizes
+// are patched in by Close().
+class WavFileWriter
+{
+public:
+    WavFileWriter();
+    ~WavFileWriter();
+
+    WavFileWriter(const WavFileWriter&) = delete;
+    WavFileWriter& operator=(const WavFileWriter&) = delete;
+
+    bool Open(const std::string& inPath, double inSampleRate, uint32_t inNumChannels, std::string& outError);
+
+    // inChannels holds the channel count given to Open()
+    bool Write(const float* const* inChannels, uint32_t inFrames, std::string& outError);
+    bool Close(std::string& outError);
+
+private:
+    FILE* mFile;
+    std::string mPath;
+    uint32_t mNumChannels;
+    uint64_t mDataBytes;
+    std::vector<const float*> mChannelPtrs;
+    std::vector<float> mInterleaved;
+};
+
+#endif /* __AudioFile_h__ */
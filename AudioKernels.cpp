@@ -0,0 +1,607 @@
+#include "AudioKernels.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define AUDIO_KERNELS_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define AUDIO_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Scalar reference set. The vector sets finish their tails with these. Built
+// with -ffp-contract=off (see CMakeLists.txt), so a + g * (b - a) rounds
+// twice here just as in the vector sets.
+
+void MixScalar(const float* inDry, const float* inWet, float* outOutput, float inWetGain, uint32_t inFrames) {
+    for (uint32_t i = 0; i < inFrames; ++i) {
+        outOutput[i] = inDry[i] + inWetGain * (inWet[i] - inDry[i]);
+    }
+}
+
+void CrossfadeScalar(const float* inFrom, const float* inTo, float* outOutput, const float* inGains,
+                     uint32_t inFrames) {
+    for (uint32_t i = 0; i < inFrames; ++i) {
+        outOutput[i] = inFrom[i] + inGains[i] * (inTo[i] - inFrom[i]);
+    }
+}
+
+void GainRampScalar(const float* inInput, float* outOutput, float inStartGain, float inGainStep, uint32_t inFrames) {
+    for (uint32_t i = 0; i < inFrames; ++i) {
+        outOutput[i] = inInput[i] * (inStartGain + static_cast<float>(i) * inGainStep);
+    }
+}
+
+void AccumulateScalar(const float* inInput, float* ioOutput, float inGain, uint32_t inFrames) {
+    for (uint32_t i = 0; i < inFrames; ++i) {
+        ioOutput[i] += inGain * inInput[i];
+    }
+}
+
+void InterleaveScalar(const float* const* inChannels, float* outInterleaved, uint32_t inNumChannels,
+                      uint32_t inFrames) {
+    for (uint32_t channel = 0; channel < inNumChannels; ++channel) {
+        const float* input = inChannels[channel];
+        float* output = outInterleaved + channel;
+        for (uint32_t i = 0; i < inFrames; ++i) {
+            output[static_cast<size_t>(i) * inNumChannels] = input[i];
+        }
+    }
+}
+
+void DeinterleaveScalar(const float* inInterleaved, float* const* outChannels, uint32_t inNumChannels,
+                        uint32_t inFrames) {
+    for (uint32_t channel = 0; channel < inNumChannels; ++channel) {
+        const float* input = inInterleaved + channel;
+        float* output = outChannels[channel];
+        for (uint32_t i = 0; i < inFrames; ++i) {
+            output[i] = input[static_cast<size_t>(i) * inNumChannels];
+        }
+    }
+}
+
+void FlushDenormalsScalar(float* ioData, uint32_t inFrames) {
+    for (uint32_t i = 0; i < inFrames; ++i) {
+        // False for NaN, which is kept
+        if (std::fabs(ioData[i]) < FLT_MIN) {
+            ioData[i] = 0.0f;
+        }
+    }
+}
+
+float PeakScalar(const float* inInput, uint32_t inFrames) {
+    float peak = 0.0f;
+    for (uint32_t i = 0; i < inFrames; ++i) {
+        // Keeps the peak when the sample is NaN
+        peak = std::max(peak, std::fabs(inInput[i]));
+    }
+    return peak;
+}
+
+float DifferenceAtLag(const float* inInput, uint32_t inWindow, uint32_t inLag) {
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < inWindow; ++i) {
+        const float delta = inInput[i] - inInput[i + inLag];
+        sum += delta * delta;
+    }
+    return sum;
+}
+
+void DifferenceScalar(const float* inInput, float* outDifference, uint32_t inWindow, uint32_t inNumLags) {
+    for (uint32_t lag = 0; lag < inNumLags; ++lag) {
+        outDifference[lag] = DifferenceAtLag(inInput, inWindow, lag);
+    }
+}
+
+const AudioKernels kScalarKernels = {
+    MixScalar,
+    CrossfadeScalar,
+    GainRampScalar,
+    AccumulateScalar,
+    InterleaveScalar,
+    DeinterleaveScalar,
+    FlushDenormalsScalar,
+    PeakScalar,
+    DifferenceScalar,
+    "scalar"
+};
+
+#if AUDIO_KERNELS_X86
+
+// SSE2: part of the x86_64 baseline, always available
+
+void MixSse2(const float* inDry, const float* inWet, float* outOutput, float inWetGain, uint32_t inFrames) {
+    const __m128 gain = _mm_set1_ps(inWetGain);
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        const __m128 dry = _mm_loadu_ps(inDry + i);
+        const __m128 wet = _mm_loadu_ps(inWet + i);
+        _mm_storeu_ps(outOutput + i, _mm_add_ps(dry, _mm_mul_ps(gain, _mm_sub_ps(wet, dry))));
+    }
+    MixScalar(inDry + i, inWet + i, outOutput + i, inWetGain, inFrames - i);
+}
+
+void CrossfadeSse2(const float* inFrom, const float* inTo, float* outOutput, const float* inGains,
+                   uint32_t inFrames) {
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        const __m128 from = _mm_loadu_ps(inFrom + i);
+        const __m128 to = _mm_loadu_ps(inTo + i);
+        const __m128 gain = _mm_loadu_ps(inGains + i);
+        _mm_storeu_ps(outOutput + i, _mm_add_ps(from, _mm_mul_ps(gain, _mm_sub_ps(to, from))));
+    }
+    CrossfadeScalar(inFrom + i, inTo + i, outOutput + i, inGains + i, inFrames - i);
+}
+
+void GainRampSse2(const float* inInput, float* outOutput, float inStartGain, float inGainStep, uint32_t inFrames) {
+    const __m128 start = _mm_set1_ps(inStartGain);
+    const __m128 step = _mm_set1_ps(inGainStep);
+    const __m128 four = _mm_set1_ps(4.0f);
+    __m128 index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        const __m128 gain = _mm_add_ps(start, _mm_mul_ps(index, step));
+        _mm_storeu_ps(outOutput + i, _mm_mul_ps(_mm_loadu_ps(inInput + i), gain));
+        index = _mm_add_ps(index, four);
+    }
+    for (; i < inFrames; ++i) {
+        outOutput[i] = inInput[i] * (inStartGain + static_cast<float>(i) * inGainStep);
+    }
+}
+
+void AccumulateSse2(const float* inInput, float* ioOutput, float inGain, uint32_t inFrames) {
+    const __m128 gain = _mm_set1_ps(inGain);
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        const __m128 sum = _mm_add_ps(_mm_loadu_ps(ioOutput + i), _mm_mul_ps(gain, _mm_loadu_ps(inInput + i)));
+        _mm_storeu_ps(ioOutput + i, sum);
+    }
+    AccumulateScalar(inInput + i, ioOutput + i, inGain, inFrames - i);
+}
+
+void InterleaveSse2(const float* const* inChannels, float* outInterleaved, uint32_t inNumChannels,
+                    uint32_t inFrames) {
+    if (inNumChannels != 2) {
+        InterleaveScalar(inChannels, outInterleaved, inNumChannels, inFrames);
+        return;
+    }
+    const float* left = inChannels[0];
+    const float* right = inChannels[1];
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        const __m128 l = _mm_loadu_ps(left + i);
+        const __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(outInterleaved + 2 * i, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(outInterleaved + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+    const float* tails[2] = { left + i, right + i };
+    InterleaveScalar(tails, outInterleaved + 2 * i, 2, inFrames - i);
+}
+
+void DeinterleaveSse2(const float* inInterleaved, float* const* outChannels, uint32_t inNumChannels,
+                      uint32_t inFrames) {
+    if (inNumChannels != 2) {
+        DeinterleaveScalar(inInterleaved, outChannels, inNumChannels, inFrames);
+        return;
+    }
+    float* left = outChannels[0];
+    float* right = outChannels[1];
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        const __m128 a = _mm_loadu_ps(inInterleaved + 2 * i);
+        const __m128 b = _mm_loadu_ps(inInterleaved + 2 * i + 4);
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    float* tails[2] = { left + i, right + i };
+    DeinterleaveScalar(inInterleaved + 2 * i, tails, 2, inFrames - i);
+}
+
+void FlushDenormalsSse2(float* ioData, uint32_t inFrames) {
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 smallest = _mm_set1_ps(FLT_MIN);
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        const __m128 value = _mm_loadu_ps(ioData + i);
+        const __m128 denormal = _mm_cmplt_ps(_mm_and_ps(value, absMask), smallest);
+        _mm_storeu_ps(ioData + i, _mm_andnot_ps(denormal, value));
+    }
+    FlushDenormalsScalar(ioData + i, inFrames - i);
+}
+
+// maxps returns its second operand when either is NaN: the running peak goes
+// second so NaN samples are skipped
+float PeakSse2(const float* inInput, uint32_t inFrames) {
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 peak = _mm_setzero_ps();
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        peak = _mm_max_ps(_mm_and_ps(_mm_loadu_ps(inInput + i), absMask), peak);
+    }
+    peak = _mm_max_ps(peak, _mm_movehl_ps(peak, peak));
+    peak = _mm_max_ss(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 1, 1, 1)));
+    return std::max(_mm_cvtss_f32(peak), PeakScalar(inInput + i, inFrames - i));
+}
+
+// Four lags at a time, each lane summing in the scalar order
+void DifferenceSse2(const float* inInput, float* outDifference, uint32_t inWindow, uint32_t inNumLags) {
+    uint32_t lag = 0;
+    for (; lag + 4 <= inNumLags; lag += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (uint32_t i = 0; i < inWindow; ++i) {
+            const __m128 delta = _mm_sub_ps(_mm_set1_ps(inInput[i]), _mm_loadu_ps(inInput + i + lag));
+            sum = _mm_add_ps(sum, _mm_mul_ps(delta, delta));
+        }
+        _mm_storeu_ps(outDifference + lag, sum);
+    }
+    for (; lag < inNumLags; ++lag) {
+        outDifference[lag] = DifferenceAtLag(inInput, inWindow, lag);
+    }
+}
+
+const AudioKernels kSse2Kernels = {
+    MixSse2,
+    CrossfadeSse2,
+    GainRampSse2,
+    AccumulateSse2,
+    InterleaveSse2,
+    DeinterleaveSse2,
+    FlushDenormalsSse2,
+    PeakSse2,
+    DifferenceSse2,
+    "sse2"
+};
+
+// AVX2: compiled for the target per function, so the rest of the binary
+// keeps the baseline instruction set; only called after the CPU check
+#define AUDIO_KERNELS_AVX2 __attribute__((target("avx2")))
+
+AUDIO_KERNELS_AVX2
+void MixAvx2(const float* inDry, const float* inWet, float* outOutput, float inWetGain, uint32_t inFrames) {
+    const __m256 gain = _mm256_set1_ps(inWetGain);
+    uint32_t i = 0;
+    for (; i + 8 <= inFrames; i += 8) {
+        const __m256 dry = _mm256_loadu_ps(inDry + i);
+        const __m256 wet = _mm256_loadu_ps(inWet + i);
+        _mm256_storeu_ps(outOutput + i, _mm256_add_ps(dry, _mm256_mul_ps(gain, _mm256_sub_ps(wet, dry))));
+    }
+    MixSse2(inDry + i, inWet + i, outOutput + i, inWetGain, inFrames - i);
+}
+
+AUDIO_KERNELS_AVX2
+void CrossfadeAvx2(const float* inFrom, const float* inTo, float* outOutput, const float* inGains,
+                   uint32_t inFrames) {
+    uint32_t i = 0;
+    for (; i + 8 <= inFrames; i += 8) {
+        const __m256 from = _mm256_loadu_ps(inFrom + i);
+        const __m256 to = _mm256_loadu_ps(inTo + i);
+        const __m256 gain = _mm256_loadu_ps(inGains + i);
+        _mm256_storeu_ps(outOutput + i, _mm256_add_ps(from, _mm256_mul_ps(gain, _mm256_sub_ps(to, from))));
+    }
+    CrossfadeSse2(inFrom + i, inTo + i, outOutput + i, inGains + i, inFrames - i);
+}
+
+AUDIO_KERNELS_AVX2
+void GainRampAvx2(const float* inInput, float* outOutput, float inStartGain, float inGainStep, uint32_t inFrames) {
+    const __m256 start = _mm256_set1_ps(inStartGain);
+    const __m256 step = _mm256_set1_ps(inGainStep);
+    const __m256 eight = _mm256_set1_ps(8.0f);
+    __m256 index = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    uint32_t i = 0;
+    for (; i + 8 <= inFrames; i += 8) {
+        const __m256 gain = _mm256_add_ps(start, _mm256_mul_ps(index, step));
+        _mm256_storeu_ps(outOutput + i, _mm256_mul_ps(_mm256_loadu_ps(inInput + i), gain));
+        index = _mm256_add_ps(index, eight);
+    }
+    for (; i < inFrames; ++i) {
+        outOutput[i] = inInput[i] * (inStartGain + static_cast<float>(i) * inGainStep);
+    }
+}
+
+AUDIO_KERNELS_AVX2
+void AccumulateAvx2(const float* inInput, float* ioOutput, float inGain, uint32_t inFrames) {
+    const __m256 gain = _mm256_set1_ps(inGain);
+    uint32_t i = 0;
+    for (; i + 8 <= inFrames; i += 8) {
+        const __m256 sum = _mm256_add_ps(_mm256_loadu_ps(ioOutput + i),
+                                         _mm256_mul_ps(gain, _mm256_loadu_ps(inInput + i)));
+        _mm256_storeu_ps(ioOutput + i, sum);
+    }
+    AccumulateSse2(inInput + i, ioOutput + i, inGain, inFrames - i);
+}
+
+AUDIO_KERNELS_AVX2
+void InterleaveAvx2(const float* const* inChannels, float* outInterleaved, uint32_t inNumChannels,
+                    uint32_t inFrames) {
+    if (inNumChannels != 2) {
+        InterleaveScalar(inChannels, outInterleaved, inNumChannels, inFrames);
+        return;
+    }
+    const float* left = inChannels[0];
+    const float* right = inChannels[1];
+    uint32_t i = 0;
+    for (; i + 8 <= inFrames; i += 8) {
+        const __m256 l = _mm256_loadu_ps(left + i);
+        const __m256 r = _mm256_loadu_ps(right + i);
+        // Unpacks work per 128-bit lane: lo = frames 0-1 | 4-5, hi = 2-3 | 6-7
+        const __m256 lo = _mm256_unpacklo_ps(l, r);
+        const __m256 hi = _mm256_unpackhi_ps(l, r);
+        _mm256_storeu_ps(outInterleaved + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(outInterleaved + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    const float* tails[2] = { left + i, right + i };
+    InterleaveSse2(tails, outInterleaved + 2 * i, 2, inFrames - i);
+}
+
+AUDIO_KERNELS_AVX2
+void DeinterleaveAvx2(const float* inInterleaved, float* const* outChannels, uint32_t inNumChannels,
+                      uint32_t inFrames) {
+    if (inNumChannels != 2) {
+        DeinterleaveScalar(inInterleaved, outChannels, inNumChannels, inFrames);
+        return;
+    }
+    float* left = outChannels[0];
+    float* right = outChannels[1];
+    uint32_t i = 0;
+    for (; i + 8 <= inFrames; i += 8) {
+        const __m256 a = _mm256_loadu_ps(inInterleaved + 2 * i);
+        const __m256 b = _mm256_loadu_ps(inInterleaved + 2 * i + 8);
+        // Regroup into frames 0-1,4-5 | 2-3,6-7 per lane, then split
+        const __m256 lo = _mm256_permute2f128_ps(a, b, 0x20);
+        const __m256 hi = _mm256_permute2f128_ps(a, b, 0x31);
+        _mm256_storeu_ps(left + i, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm256_storeu_ps(right + i, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    float* tails[2] = { left + i, right + i };
+    DeinterleaveSse2(inInterleaved + 2 * i, tails, 2, inFrames - i);
+}
+
+AUDIO_KERNELS_AVX2
+void FlushDenormalsAvx2(float* ioData, uint32_t inFrames) {
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 smallest = _mm256_set1_ps(FLT_MIN);
+    uint32_t i = 0;
+    for (; i + 8 <= inFrames; i += 8) {
+        const __m256 value = _mm256_loadu_ps(ioData + i);
+        const __m256 denormal = _mm256_cmp_ps(_mm256_and_ps(value, absMask), smallest, _CMP_LT_OQ);
+        _mm256_storeu_ps(ioData + i, _mm256_andnot_ps(denormal, value));
+    }
+    FlushDenormalsSse2(ioData + i, inFrames - i);
+}
+
+AUDIO_KERNELS_AVX2
+float PeakAvx2(const float* inInput, uint32_t inFrames) {
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 peak = _mm256_setzero_ps();
+    uint32_t i = 0;
+    for (; i + 8 <= inFrames; i += 8) {
+        peak = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(inInput + i), absMask), peak);
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, peak);
+    float result = PeakSse2(inInput + i, inFrames - i);
+    for (float lane : lanes) {
+        result = std::max(result, lane);
+    }
+    return result;
+}
+
+AUDIO_KERNELS_AVX2
+void DifferenceAvx2(const float* inInput, float* outDifference, uint32_t inWindow, uint32_t inNumLags) {
+    uint32_t lag = 0;
+    for (; lag + 8 <= inNumLags; lag += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (uint32_t i = 0; i < inWindow; ++i) {
+            const __m256 delta = _mm256_sub_ps(_mm256_set1_ps(inInput[i]), _mm256_loadu_ps(inInput + i + lag));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(delta, delta));
+        }
+        _mm256_storeu_ps(outDifference + lag, sum);
+    }
+    for (; lag < inNumLags; ++lag) {
+        outDifference[lag] = DifferenceAtLag(inInput, inWindow, lag);
+    }
+}
+
+const AudioKernels kAvx2Kernels = {
+    MixAvx2,
+    CrossfadeAvx2,
+    GainRampAvx2,
+    AccumulateAvx2,
+    InterleaveAvx2,
+    DeinterleaveAvx2,
+    FlushDenormalsAvx2,
+    PeakAvx2,
+    DifferenceAvx2,
+    "avx2"
+};
+
+#endif // AUDIO_KERNELS_X86
+
+#if AUDIO_KERNELS_NEON
+
+// NEON: part of the arm64 baseline. Multiply and add stay separate
+// instructions so results match the scalar set.
+
+void MixNeon(const float* inDry, const float* inWet, float* outOutput, float inWetGain, uint32_t inFrames) {
+    const float32x4_t gain = vdupq_n_f32(inWetGain);
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        const float32x4_t dry = vld1q_f32(inDry + i);
+        const float32x4_t wet = vld1q_f32(inWet + i);
+        vst1q_f32(outOutput + i, vaddq_f32(dry, vmulq_f32(gain, vsubq_f32(wet, dry))));
+    }
+    MixScalar(inDry + i, inWet + i, outOutput + i, inWetGain, inFrames - i);
+}
+
+void CrossfadeNeon(const float* inFrom, const float* inTo, float* outOutput, const float* inGains,
+                   uint32_t inFrames) {
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        const float32x4_t from = vld1q_f32(inFrom + i);
+        const float32x4_t to = vld1q_f32(inTo + i);
+        const float32x4_t gain = vld1q_f32(inGains + i);
+        vst1q_f32(outOutput + i, vaddq_f32(from, vmulq_f32(gain, vsubq_f32(to, from))));
+    }
+    CrossfadeScalar(inFrom + i, inTo + i, outOutput + i, inGains + i, inFrames - i);
+}
+
+void GainRampNeon(const float* inInput, float* outOutput, float inStartGain, float inGainStep, uint32_t inFrames) {
+    const float32x4_t start = vdupq_n_f32(inStartGain);
+    const float32x4_t step = vdupq_n_f32(inGainStep);
+    const float32x4_t four = vdupq_n_f32(4.0f);
+    const float initial[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+    float32x4_t index = vld1q_f32(initial);
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        const float32x4_t gain = vaddq_f32(start, vmulq_f32(index, step));
+        vst1q_f32(outOutput + i, vmulq_f32(vld1q_f32(inInput + i), gain));
+        index = vaddq_f32(index, four);
+    }
+    for (; i < inFrames; ++i) {
+        outOutput[i] = inInput[i] * (inStartGain + static_cast<float>(i) * inGainStep);
+    }
+}
+
+void AccumulateNeon(const float* inInput, float* ioOutput, float inGain, uint32_t inFrames) {
+    const float32x4_t gain = vdupq_n_f32(inGain);
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        vst1q_f32(ioOutput + i, vaddq_f32(vld1q_f32(ioOutput + i), vmulq_f32(gain, vld1q_f32(inInput + i))));
+    }
+    AccumulateScalar(inInput + i, ioOutput + i, inGain, inFrames - i);
+}
+
+void InterleaveNeon(const float* const* inChannels, float* outInterleaved, uint32_t inNumChannels,
+                    uint32_t inFrames) {
+    if (inNumChannels != 2) {
+        InterleaveScalar(inChannels, outInterleaved, inNumChannels, inFrames);
+        return;
+    }
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        float32x4x2_t pair;
+        pair.val[0] = vld1q_f32(inChannels[0] + i);
+        pair.val[1] = vld1q_f32(inChannels[1] + i);
+        vst2q_f32(outInterleaved + 2 * i, pair);
+    }
+    const float* tails[2] = { inChannels[0] + i, inChannels[1] + i };
+    InterleaveScalar(tails, outInterleaved + 2 * i, 2, inFrames - i);
+}
+
+void DeinterleaveNeon(const float* inInterleaved, float* const* outChannels, uint32_t inNumChannels,
+                      uint32_t inFrames) {
+    if (inNumChannels != 2) {
+        DeinterleaveScalar(inInterleaved, outChannels, inNumChannels, inFrames);
+        return;
+    }
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        const float32x4x2_t pair = vld2q_f32(inInterleaved + 2 * i);
+        vst1q_f32(outChannels[0] + i, pair.val[0]);
+        vst1q_f32(outChannels[1] + i, pair.val[1]);
+    }
+    float* tails[2] = { outChannels[0] + i, outChannels[1] + i };
+    DeinterleaveScalar(inInterleaved + 2 * i, tails, 2, inFrames - i);
+}
+
+void FlushDenormalsNeon(float* ioData, uint32_t inFrames) {
+    const float32x4_t smallest = vdupq_n_f32(FLT_MIN);
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        const float32x4_t value = vld1q_f32(ioData + i);
+        const uint32x4_t denormal = vcaltq_f32(value, smallest);
+        vst1q_f32(ioData + i, vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(value), denormal)));
+    }
+    FlushDenormalsScalar(ioData + i, inFrames - i);
+}
+
+// vmaxnm returns the number when one side is NaN
+float PeakNeon(const float* inInput, uint32_t inFrames) {
+    float32x4_t peak = vdupq_n_f32(0.0f);
+    uint32_t i = 0;
+    for (; i + 4 <= inFrames; i += 4) {
+        peak = vmaxnmq_f32(peak, vabsq_f32(vld1q_f32(inInput + i)));
+    }
+    return std::max(vmaxvq_f32(peak), PeakScalar(inInput + i, inFrames - i));
+}
+
+void DifferenceNeon(const float* inInput, float* outDifference, uint32_t inWindow, uint32_t inNumLags) {
+    uint32_t lag = 0;
+    for (; lag + 4 <= inNumLags; lag += 4) {
+        float32x4_t sum = vdupq_n_f32(0.0f);
+        for (uint32_t i = 0; i < inWindow; ++i) {
+            const float32x4_t delta = vsubq_f32(vdupq_n_f32(inInput[i]), vld1q_f32(inInput + i + lag));
+            sum = vaddq_f32(sum, vmulq_f32(delta, delta));
+        }
+        vst1q_f32(outDifference + lag, sum);
+    }
+    for (; lag < inNumLags; ++lag) {
+        outDifference[lag] = DifferenceAtLag(inInput, inWindow, lag);
+    }
+}
+
+const AudioKernels kNeonKernels = {
+    MixNeon,
+    CrossfadeNeon,
+    GainRampNeon,
+    AccumulateNeon,
+    InterleaveNeon,
+    DeinterleaveNeon,
+    FlushDenormalsNeon,
+    PeakNeon,
+    DifferenceNeon,
+    "neon"
+};
+
+#endif // AUDIO_KERNELS_NEON
+
+// Supported sets, widest first
+const AudioKernels* const* GetSupportedKernels() {
+    static const AudioKernels* sSupported[4] = {};
+    static const bool sDetected = [] {
+        uint32_t count = 0;
+#if AUDIO_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            sSupported[count++] = &kAvx2Kernels;
+        }
+        sSupported[count++] = &kSse2Kernels;
+#elif AUDIO_KERNELS_NEON
+        sSupported[count++] = &kNeonKernels;
+#endif
+        sSupported[count] = &kScalarKernels;
+        return true;
+    }();
+    (void)sDetected;
+    return sSupported;
+}
+
+const AudioKernels& SelectKernels() {
+    const AudioKernels* const* supported = GetSupportedKernels();
+    const char* requested = getenv("PITCHSHIFTER_KERNELS");
+    if (requested) {
+        for (uint32_t i = 0; supported[i]; ++i) {
+            if (strcmp(supported[i]->name, requested) == 0) {
+                return *supported[i];
+            }
+        }
+    }
+    return *supported[0];
+}
+
+} // namespace
+
+const AudioKernels& GetAudioKernels() {
+    static const AudioKernels& sKernels = SelectKernels();
+    return sKernels;
+}
+
+const AudioKernels& GetScalarAudioKernels() {
+    return kScalarKernels;
+}
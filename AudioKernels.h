@@ -0,0 +1,61 @@
+// Standard library headers
+#include <cstdint>
+
+// Include guards
+#ifndef __AudioKernels_h__
+#define __AudioKernels_h__
+
+// Vectorized inner loops for the render path, as a table of function
+// pointers. GetAudioKernels() picks the widest set the CPU supports once
+// (AVX2 or SSE2 on x86_64, NEON on arm64, plain C++ elsewhere), so one
+// universal binary runs the right code on every machine.
+//
+// Every set computes the same thing as the scalar reference set, in the same
+// order of operations and with the same roundings, NaN and infinities
+// included. Outputs may alias an input exactly but must not partially
+// overlap one. None of the kernels allocate.
+struct AudioKernels
+{
+    // outOutput = inDry + inWetGain * (inWet - inDry)
+    void (*Mix)(const float* inDry, const float* inWet, float* outOutput, float inWetGain, uint32_t inFrames);
+
+    // outOutput = inFrom + inGains * (inTo - inFrom), one gain per frame
+    void (*Crossfade)(const float* inFrom, const float* inTo, float* outOutput, const float* inGains,
+                      uint32_t inFrames);
+
+    // outOutput[i] = inInput[i] * (inStartGain + i * inGainStep)
+    void (*GainRamp)(const float* inInput, float* outOutput, float inStartGain, float inGainStep, uint32_t inFrames);
+
+    // ioOutput += inGain * inInput
+    void (*Accumulate)(const float* inInput, float* ioOutput, float inGain, uint32_t inFrames);
+
+    // Between non-interleaved channel buffers and one interleaved buffer
+    void (*Interleave)(const float* const* inChannels, float* outInterleaved, uint32_t inNumChannels,
+                       uint32_t inFrames);
+    void (*Deinterleave)(const float* inInterleaved, float* const* outChannels, uint32_t inNumChannels,
+                         uint32_t inFrames);
+
+    // Replaces denormals (and negative zero) with zero; NaN and infinities
+    // pass through
+    void (*FlushDenormals)(float* ioData, uint32_t inFrames);
+
+    // Largest absolute sample value, 0 for no frames. NaN samples are
+    // skipped; infinities count.
+    float (*Peak)(const float* inInput, uint32_t inFrames);
+
+    // outDifference[lag] = sum over i < inWindow of (inInput[i] - inInput[i + lag])^2
+    // for lag < inNumLags; reads inWindow + inNumLags - 1 samples
+    void (*Difference)(const float* inInput, float* outDifference, uint32_t inWindow, uint32_t inNumLags);
+
+    const char* name;
+};
+
+// The kernels for this CPU. The PITCHSHIFTER_KERNELS environment variable
+// (scalar, sse2, avx2 or neon) selects a narrower supported set, for
+// comparisons and benchmarks.
+const AudioKernels& GetAudioKernels();
+
+// The plain C++ reference set
+const AudioKernels& GetScalarAudioKernels();
+
+#endif /* __AudioKernels_h__ */
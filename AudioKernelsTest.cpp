@@ -0,0 +1,281 @@
+// Checks the dispatched AudioKernels set against the scalar reference set.
+// CTest runs it once per set, selected through PITCHSHIFTER_KERNELS; a set
+// this CPU does not support is reported as skipped.
+//
+// Every kernel runs over lengths that leave every possible vector tail, from
+// unaligned start addresses, both out of place and with the output aliasing
+// an input. The inputs mix ordinary samples with denormals, signed zeros,
+// infinities and NaN. Results must match the reference bit for bit (any NaN
+// matches any NaN), and FlushDenormals and Peak must follow the documented
+// NaN and infinity policy.
+
+#include "AudioKernels.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// Exit code CTest reads as skipped (SKIP_RETURN_CODE)
+const int kSkipped = 77;
+
+// Every length up to a few vectors wide, plus block-sized ones
+const uint32_t kMaxShortLength = 40;
+const uint32_t kLongLengths[] = { 63, 64, 65, 255, 256, 257, 1023 };
+
+// Start offsets in floats from a 64-byte aligned buffer
+const uint32_t kMaxOffset = 7;
+
+const uint32_t kMaxChannels = 4;
+
+// Difference: window lengths and lag counts around the vector widths
+const uint32_t kWindows[] = { 1, 3, 8, 17, 64 };
+const uint32_t kMaxLags = 19;
+
+const float kNaN = std::numeric_limits<float>::quiet_NaN();
+const float kInfinity = std::numeric_limits<float>::infinity();
+const float kSpecials[] = { FLT_MIN * 0.5f, -FLT_TRUE_MIN, FLT_MIN, -FLT_MIN, 0.0f, -0.0f, kInfinity, -kInfinity,
+                            kNaN, -kNaN };
+
+uint32_t gFailures = 0;
+
+// Deterministic noise in [-1, 1]
+uint32_t gSeed = 1;
+float Noise() {
+    gSeed = gSeed * 1664525u + 1013904223u;
+    return static_cast<float>(gSeed >> 8) / static_cast<float>(1u << 23) - 1.0f;
+}
+
+// Content of a test buffer: plain noise, or noise with a special value at
+// every few frames
+enum Fill
+{
+    kFill_Noise,
+    kFill_Specials,
+    kNumberOfFills
+};
+
+const char* GetFillName(uint32_t inFill) {
+    return (inFill == kFill_Noise) ? "noise" : "specials";
+}
+
+void FillBuffer(float* outData, uint32_t inFrames, uint32_t inFill) {
+    for (uint32_t i = 0; i < inFrames; ++i) {
+        outData[i] = Noise();
+        if (inFill == kFill_Specials && (gSeed >> 28) < 5) {
+            outData[i] = kSpecials[(gSeed >> 12) % (sizeof(kSpecials) / sizeof(kSpecials[0]))];
+        }
+    }
+}
+
+bool Same(float inA, float inB) {
+    if (std::isnan(inA) || std::isnan(inB)) {
+        return std::isnan(inA) && std::isnan(inB);
+    }
+    return memcmp(&inA, &inB, sizeof(float)) == 0;
+}
+
+// Compares and reports the first mismatch
+void Expect(const float* inActual, const float* inExpected, uint32_t inFrames, const char* inKernel,
+            const char* inCase, uint32_t inLength, uint32_t inOffset, uint32_t inFill) {
+    for (uint32_t i = 0; i < inFrames; ++i) {
+        if (!Same(inActual[i], inExpected[i])) {
+            printf("FAIL %s (%s) length %u offset %u %s: [%u] %.9g, expected %.9g\n", inKernel, inCase, inLength,
+                   inOffset, GetFillName(inFill), i, inActual[i], inExpected[i]);
+            ++gFailures;
+            return;
+        }
+    }
+}
+
+// A 64-byte aligned scratch buffer with room for the largest case
+class Buffer
+{
+public:
+    explicit Buffer(size_t inFrames) : mStorage(inFrames + kMaxOffset + 16) {}
+
+    float* At(uint32_t inOffset) {
+        const uintptr_t address = reinterpret_cast<uintptr_t>(mStorage.data());
+        const uintptr_t aligned = (address + 63) & ~static_cast<uintptr_t>(63);
+        return reinterpret_cast<float*>(aligned) + inOffset;
+    }
+
+private:
+    std::vector<float> mStorage;
+};
+
+void TestElementwise(const AudioKernels& inKernels, const AudioKernels& inReference, uint32_t inLength,
+                     uint32_t inOffset, uint32_t inFill) {
+    Buffer a(inLength), b(inLength), gains(inLength), expected(inLength), actual(inLength);
+    float* inA = a.At(inOffset);
+    float* inB = b.At(inOffset);
+    float* inGains = gains.At(inOffset);
+    float* outExpected = expected.At(inOffset);
+    float* outActual = actual.At(inOffset);
+    FillBuffer(inA, inLength, inFill);
+    FillBuffer(inB, inLength, inFill);
+    FillBuffer(inGains, inLength, kFill_Noise);
+    const float gain = Noise();
+    const float step = Noise() / 64.0f;
+
+    // Out of place, then in place on each aliasable input
+    inReference.Mix(inA, inB, outExpected, gain, inLength);
+    inKernels.Mix(inA, inB, outActual, gain, inLength);
+    Expect(outActual, outExpected, inLength, "Mix", "out of place", inLength, inOffset, inFill);
+    memcpy(outActual, inA, inLength * sizeof(float));
+    inKernels.Mix(outActual, inB, outActual, gain, inLength);
+    Expect(outActual, outExpected, inLength, "Mix", "dry in place", inLength, inOffset, inFill);
+    memcpy(outActual, inB, inLength * sizeof(float));
+    inKernels.Mix(inA, outActual, outActual, gain, inLength);
+    Expect(outActual, outExpected, inLength, "Mix", "wet in place", inLength, inOffset, inFill);
+
+    inReference.Crossfade(inA, inB, outExpected, inGains, inLength);
+    inKernels.Crossfade(inA, inB, outActual, inGains, inLength);
+    Expect(outActual, outExpected, inLength, "Crossfade", "out of place", inLength, inOffset, inFill);
+    memcpy(outActual, inA, inLength * sizeof(float));
+    inKernels.Crossfade(outActual, inB, outActual, inGains, inLength);
+    Expect(outActual, outExpected, inLength, "Crossfade", "from in place", inLength, inOffset, inFill);
+    memcpy(outActual, inB, inLength * sizeof(float));
+    inKernels.Crossfade(inA, outActual, outActual, inGains, inLength);
+    Expect(outActual, outExpected, inLength, "Crossfade", "to in place", inLength, inOffset, inFill);
+
+    inReference.GainRamp(inA, outExpected, gain, step, inLength);
+    inKernels.GainRamp(inA, outActual, gain, step, inLength);
+    Expect(outActual, outExpected, inLength, "GainRamp", "out of place", inLength, inOffset, inFill);
+    memcpy(outActual, inA, inLength * sizeof(float));
+    inKernels.GainRamp(outActual, outActual, gain, step, inLength);
+    Expect(outActual, outExpected, inLength, "GainRamp", "in place", inLength, inOffset, inFill);
+
+    memcpy(outExpected, inB, inLength * sizeof(float));
+    memcpy(outActual, inB, inLength * sizeof(float));
+    inReference.Accumulate(inA, outExpected, gain, inLength);
+    inKernels.Accumulate(inA, outActual, gain, inLength);
+    Expect(outActual, outExpected, inLength, "Accumulate", "out of place", inLength, inOffset, inFill);
+    memcpy(outExpected, inA, inLength * sizeof(float));
+    memcpy(outActual, inA, inLength * sizeof(float));
+    inReference.Accumulate(outExpected, outExpected, gain, inLength);
+    inKernels.Accumulate(outActual, outActual, gain, inLength);
+    Expect(outActual, outExpected, inLength, "Accumulate", "in place", inLength, inOffset, inFill);
+
+    memcpy(outExpected, inA, inLength * sizeof(float));
+    memcpy(outActual, inA, inLength * sizeof(float));
+    inReference.FlushDenormals(outExpected, inLength);
+    inKernels.FlushDenormals(outActual, inLength);
+    Expect(outActual, outExpected, inLength, "FlushDenormals", "in place", inLength, inOffset, inFill);
+
+    const float expectedPeak = inReference.Peak(inA, inLength);
+    const float actualPeak = inKernels.Peak(inA, inLength);
+    Expect(&actualPeak, &expectedPeak, 1, "Peak", "value", inLength, inOffset, inFill);
+}
+
+void TestInterleave(const AudioKernels& inKernels, const AudioKernels& inReference, uint32_t inLength,
+                    uint32_t inOffset, uint32_t inFill) {
+    for (uint32_t numChannels = 1; numChannels <= kMaxChannels; ++numChannels) {
+        Buffer channels(static_cast<size_t>(kMaxChannels) * (inLength + 16));
+        Buffer expected(static_cast<size_t>(kMaxChannels) * inLength), actual(static_cast<size_t>(kMaxChannels) * inLength);
+        const float* inputs[kMaxChannels];
+        float* outputs[kMaxChannels];
+        for (uint32_t channel = 0; channel < numChannels; ++channel) {
+            float* data = channels.At(inOffset) + static_cast<size_t>(channel) * (inLength + 16);
+            FillBuffer(data, inLength, inFill);
+            inputs[channel] = data;
+        }
+
+        const uint32_t samples = numChannels * inLength;
+        inReference.Interleave(inputs, expected.At(inOffset), numChannels, inLength);
+        inKernels.Interleave(inputs, actual.At(inOffset), numChannels, inLength);
+        Expect(actual.At(inOffset), expected.At(inOffset), samples, "Interleave", "channels", inLength, inOffset, inFill);
+
+        Buffer split(static_cast<size_t>(kMaxChannels) * (inLength + 16));
+        for (uint32_t channel = 0; channel < numChannels; ++channel) {
+            outputs[channel] = split.At(inOffset) + static_cast<size_t>(channel) * (inLength + 16);
+        }
+        inKernels.Deinterleave(expected.At(inOffset), outputs, numChannels, inLength);
+        for (uint32_t channel = 0; channel < numChannels; ++channel) {
+            Expect(outputs[channel], inputs[channel], inLength, "Deinterleave", "round trip", inLength, inOffset,
+                   inFill);
+        }
+    }
+}
+
+void TestDifference(const AudioKernels& inKernels, const AudioKernels& inReference, uint32_t inOffset,
+                    uint32_t inFill) {
+    for (uint32_t window : kWindows) {
+        for (uint32_t numLags = 0; numLags <= kMaxLags; ++numLags) {
+            const uint32_t length = window + kMaxLags;
+            Buffer input(length), expected(kMaxLags), actual(kMaxLags);
+            FillBuffer(input.At(inOffset), length, inFill);
+            inReference.Difference(input.At(inOffset), expected.At(inOffset), window, numLags);
+            inKernels.Difference(input.At(inOffset), actual.At(inOffset), window, numLags);
+            Expect(actual.At(inOffset), expected.At(inOffset), numLags, "Difference", "lags", window, inOffset,
+                   inFill);
+        }
+    }
+}
+
+// The documented policy, independent of the reference
+void TestPolicy(const AudioKernels& inKernels) {
+    for (uint32_t length = 1; length <= kMaxShortLength; ++length) {
+        for (uint32_t position = 0; position < length; ++position) {
+            std::vector<float> data(length, 0.5f);
+
+            // NaN and infinities survive the flush; denormals and -0 don't
+            const float flushed[] = { kNaN, kInfinity, -kInfinity, FLT_MIN * 0.5f, -FLT_TRUE_MIN, -0.0f };
+            const float kept[] = { kNaN, kInfinity, -kInfinity, 0.0f, 0.0f, 0.0f };
+            for (uint32_t i = 0; i < sizeof(flushed) / sizeof(flushed[0]); ++i) {
+                data[position] = flushed[i];
+                inKernels.FlushDenormals(data.data(), length);
+                Expect(&data[position], &kept[i], 1, "FlushDenormals", "policy", length, position, kFill_Specials);
+            }
+
+            // Peak skips NaN and counts infinities
+            data.assign(length, -0.25f);
+            data[position] = kNaN;
+            const float skipped = inKernels.Peak(data.data(), length);
+            const float expectedSkipped = (length > 1) ? 0.25f : 0.0f;
+            Expect(&skipped, &expectedSkipped, 1, "Peak", "NaN skipped", length, position, kFill_Specials);
+            data[position] = -kInfinity;
+            const float infinite = inKernels.Peak(data.data(), length);
+            Expect(&infinite, &kInfinity, 1, "Peak", "infinity counted", length, position, kFill_Specials);
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    const AudioKernels& kernels = GetAudioKernels();
+    const AudioKernels& reference = GetScalarAudioKernels();
+    const char* requested = getenv("PITCHSHIFTER_KERNELS");
+    if (requested && strcmp(requested, kernels.name) != 0) {
+        printf("%s kernels not supported on this CPU; skipped\n", requested);
+        return kSkipped;
+    }
+
+    std::vector<uint32_t> lengths;
+    for (uint32_t length = 0; length <= kMaxShortLength; ++length) {
+        lengths.push_back(length);
+    }
+    lengths.insert(lengths.end(), std::begin(kLongLengths), std::end(kLongLengths));
+
+    for (uint32_t fill = 0; fill < kNumberOfFills; ++fill) {
+        for (uint32_t offset = 0; offset <= kMaxOffset; ++offset) {
+            for (uint32_t length : lengths) {
+                TestElementwise(kernels, reference, length, offset, fill);
+                TestInterleave(kernels, reference, length, offset, fill);
+            }
+            TestDifference(kernels, reference, offset, fill);
+        }
+    }
+    TestPolicy(kernels);
+    TestPolicy(reference);
+
+    printf("%s kernels: %u failures\n", kernels.name, gFailures);
+    return (gFailures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
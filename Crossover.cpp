@@ -0,0 +1,151 @@
+#include "Crossover.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double kButterworthQ = M_SQRT1_2;
+
+// Pole Qs of a fourth-order Butterworth
+const double kButterworth4Q[2] = { 0.54119610, 1.30656296 };
+
+// Group delay of a fourth-order Butterworth at DC, times the cutoff in rad/s
+const double kButterworth4GroupDelay = 2.61312593;
+
+// Crossover glide: coefficients are recomputed every kGlideFrames while the
+// frequency approaches its target with this time constant
+const uint32_t kGlideFrames = 32;
+const double kGlideSeconds = 0.005;
+
+inline float ProcessBiquad(const BiquadCoefficients& inCoefficients, float* ioState, float inSample) {
+    const float output = inCoefficients.b0 * inSample + ioState[0];
+    ioState[0] = inCoefficients.b1 * inSample - inCoefficients.a1 * output + ioState[1];
+    ioState[1] = inCoefficients.b2 * inSample - inCoefficients.a2 * output;
+    return output;
+}
+
+} // namespace
+
+BiquadCoefficients BiquadCoefficients::Lowpass(double inSampleRate, double inFrequency, double inQ) {
+    const double omega = 2.0 * M_PI * inFrequency / inSampleRate;
+    const double alpha = sin(omega) / (2.0 * inQ);
+    const double cosine = cos(omega);
+    const double a0 = 1.0 + alpha;
+
+    BiquadCoefficients coefficients;
+    coefficients.b0 = static_cast<float>((1.0 - cosine) * 0.5 / a0);
+    coefficients.b1 = static_cast<float>((1.0 - cosine) / a0);
+    coefficients.b2 = coefficients.b0;
+    coefficients.a1 = static_cast<float>(-2.0 * cosine / a0);
+    coefficients.a2 = static_cast<float>((1.0 - alpha) / a0);
+    return coefficients;
+}
+
+BiquadCoefficients BiquadCoefficients::Highpass(double inSampleRate, double inFrequency, double inQ) {
+    const double omega = 2.0 * M_PI * inFrequency / inSampleRate;
+    const double alpha = sin(omega) / (2.0 * inQ);
+    const double cosine = cos(omega);
+    const double a0 = 1.0 + alpha;
+
+    BiquadCoefficients coefficients;
+    coefficients.b0 = static_cast<float>((1.0 + cosine) * 0.5 / a0);
+    coefficients.b1 = static_cast<float>(-(1.0 + cosine) / a0);
+    coefficients.b2 = coefficients.b0;
+    coefficients.a1 = static_cast<float>(-2.0 * cosine / a0);
+    coefficients.a2 = static_cast<float>((1.0 - alpha) / a0);
+    return coefficients;
+}
+
+// Constructor
+LinkwitzRileyCrossover::LinkwitzRileyCrossover()
+    : mSampleRate(0.0),
+      mFrequency(0.0),
+      mTargetFrequency(0.0),
+      mGlide(0.0)
+{
+}
+
+void LinkwitzRileyCrossover::Prepare(double inSampleRate, uint32_t inNumChannels) {
+    mSampleRate = inSampleRate;
+    mGlide = exp(-static_cast<double>(kGlideFrames) / (kGlideSeconds * inSampleRate));
+    mChannels.assign(inNumChannels, ChannelState());
+}
+
+void LinkwitzRileyCrossover::Reset() {
+    std::fill(mChannels.begin(), mChannels.end(), ChannelState());
+    if (mTargetFrequency > 0.0 && mFrequency != mTargetFrequency) {
+        mFrequency = mTargetFrequency;
+        UpdateCoefficients();
+    }
+}
+
+// The first frequency applies at once, later ones glide
+void LinkwitzRileyCrossover::SetFrequency(double inFrequency) {
+    mTargetFrequency = inFrequency;
+    if (mFrequency <= 0.0) {
+        mFrequency = inFrequency;
+        UpdateCoefficients();
+    }
+}
+
+void LinkwitzRileyCrossover::UpdateCoefficients() {
+    mLowpass = BiquadCoefficients::Lowpass(mSampleRate, mFrequency, kButterworthQ);
+    mHighpass = BiquadCoefficients::Highpass(mSampleRate, mFrequency, kButterworthQ);
+}
+
+void LinkwitzRileyCrossover::Process(const float* const* inInputs, float* const* outLow, float* const* outHigh,
+                                     uint32_t inFrames) {
+    for (uint32_t start = 0; start < inFrames; start += kGlideFrames) {
+        const uint32_t end = std::min(inFrames, start + kGlideFrames);
+
+        if (mFrequency != mTargetFrequency) {
+            mFrequency = mTargetFrequency + mGlide * (mFrequency - mTargetFrequency);
+            if (std::fabs(mFrequency - mTargetFrequency) < 0.01) {
+                mFrequency = mTargetFrequency;
+            }
+            UpdateCoefficients();
+        }
+
+        for (size_t channel = 0; channel < mChannels.size(); ++channel) {
+            ChannelState& state = mChannels[channel];
+            const float* input = inInputs[channel];
+            float* low = outLow[channel];
+            float* high = outHigh[channel];
+            for (uint32_t frame = start; frame < end; ++frame) {
+                const float sample = input[frame];
+                low[frame] = ProcessBiquad(mLowpass, state.low[1], ProcessBiquad(mLowpass, state.low[0], sample));
+                high[frame] = ProcessBiquad(mHighpass, state.high[1], ProcessBiquad(mHighpass, state.high[0], sample));
+            }
+        }
+    }
+}
+
+// Constructor
+ButterworthLowpass::ButterworthLowpass()
+    : mNumChannels(0),
+      mGroupDelayFrames(0.0)
+{
+}
+
+void ButterworthLowpass::Prepare(double inSampleRate, uint32_t inNumChannels, double inFrequency) {
+    mNumChannels = inNumChannels;
+    for (int section = 0; section < 2; ++section) {
+        mSections[section] = BiquadCoefficients::Lowpass(inSampleRate, inFrequency, kButterworth4Q[section]);
+    }
+    mState.assign(static_cast<size_t>(inNumChannels) * 4, 0.0f);
+    mGroupDelayFrames = kButterworth4GroupDelay / (2.0 * M_PI * inFrequency) * inSampleRate;
+}
+
+void ButterworthLowpass::Reset() {
+    std::fill(mState.begin(), mState.end(), 0.0f);
+}
+
+void ButterworthLowpass::Process(float* const* ioData, uint32_t inFrames) {
+    for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+        float* state = mState.data() + static_cast<size_t>(channel) * 4;
+        float* data = ioData[channel];
+        for (uint32_t frame = 0; frame < inFrames; ++frame) {
+            data[frame] = ProcessBiquad(mSections[1], state + 2, ProcessBiquad(mSections[0], state, data[frame]));
+        }
+    }
+}
@@ -0,0 +1,80 @@
+// Standard library headers
+#include <cstdint>
+#include <vector>
+
+// Include guards
+#ifndef __Crossover_h__
+#define __Crossover_h__
+
+// Direct form II transposed biquad coefficients
+struct BiquadCoefficients
+{
+    float b0 = 1.0f;
+    float b1 = 0.0f;
+    float b2 = 0.0f;
+    float a1 = 0.0f;
+    float a2 = 0.0f;
+
+    // RBJ cookbook designs
+    static BiquadCoefficients Lowpass(double inSampleRate, double inFrequency, double inQ);
+    static BiquadCoefficients Highpass(double inSampleRate, double inFrequency, double inQ);
+};
+
+// Fourth-order Linkwitz-Riley band split (two cascaded Butterworth sections
+// per band). The bands sum to an allpass of the input, and both share its
+// phase response, so they recombine flat once processed with matched delay.
+// The split frequency can move on the render thread; it glides to a new
+// value over a few milliseconds so automation doesn't click.
+class LinkwitzRileyCrossover
+{
+public:
+    LinkwitzRileyCrossover();
+
+    void Prepare(double inSampleRate, uint32_t inNumChannels);
+    void Reset();
+    void SetFrequency(double inFrequency);
+
+    void Process(const float* const* inInputs, float* const* outLow, float* const* outHigh, uint32_t inFrames);
+
+private:
+    void UpdateCoefficients();
+
+    struct ChannelState
+    {
+        float low[2][2] = {};
+        float high[2][2] = {};
+    };
+
+    BiquadCoefficients mLowpass;
+    BiquadCoefficients mHighpass;
+    std::vector<ChannelState> mChannels;
+    double mSampleRate;
+    double mFrequency;
+    double mTargetFrequency;
+    double mGlide;              // Per-update smoothing factor
+};
+
+// Fourth-order Butterworth lowpass, used as the interpolation filter when a
+// decimated band is brought back to the full rate
+class ButterworthLowpass
+{
+public:
+    ButterworthLowpass();
+
+    void Prepare(double inSampleRate, uint32_t inNumChannels, double inFrequency);
+    void Reset();
+
+    // In place
+    void Process(float* const* ioData, uint32_t inFrames);
+
+    // Low-frequency group delay in frames
+    double GetGroupDelayFrames() const { return mGroupDelayFrames; }
+
+private:
+    BiquadCoefficients mSections[2];
+    std::vector<float> mState;   // Two sections by two delays per channel
+    uint32_t mNumChannels;
+    double mGroupDelayFrames;
+};
+
+#endif /* __Crossover_h__ */
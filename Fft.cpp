@@ -0,0 +1,145 @@
+#include "Fft.h"
+#include "SharedCache.h"
+#include <cmath>
+
+namespace {
+
+SharedCache<uint32_t, FftTables> sFftTables;
+
+FftTables BuildTables(uint32_t inSize) {
+    FftTables tables;
+    const uint32_t half = inSize / 2;
+
+    uint32_t bits = 0;
+    while ((1u << bits) < half) {
+        ++bits;
+    }
+    tables.bitReverse.resize(half);
+    for (uint32_t i = 0; i < half; ++i) {
+        uint32_t reversed = 0;
+        for (uint32_t bit = 0; bit < bits; ++bit) {
+            reversed |= ((i >> bit) & 1u) << (bits - 1 - bit);
+        }
+        tables.bitReverse[i] = reversed;
+    }
+
+    tables.cos.resize(half / 2);
+    tables.sin.resize(half / 2);
+    for (uint32_t i = 0; i < half / 2; ++i) {
+        tables.cos[i] = static_cast<float>(cos(2.0 * M_PI * i / half));
+        tables.sin[i] = static_cast<float>(-sin(2.0 * M_PI * i / half));
+    }
+
+    tables.splitCos.resize(half + 1);
+    tables.splitSin.resize(half + 1);
+    for (uint32_t k = 0; k <= half; ++k) {
+        tables.splitCos[k] = static_cast<float>(cos(2.0 * M_PI * k / inSize));
+        tables.splitSin[k] = static_cast<float>(-sin(2.0 * M_PI * k / inSize));
+    }
+    return tables;
+}
+
+} // namespace
+
+// Constructor
+Fft::Fft()
+    : mSize(0)
+{
+}
+
+void Fft::Prepare(uint32_t inSize) {
+    mSize = inSize;
+    mTables = sFftTables.Get(inSize, [inSize] { return BuildTables(inSize); });
+    mReal.assign(inSize / 2, 0.0f);
+    mImag.assign(inSize / 2, 0.0f);
+}
+
+void Fft::Transform(bool inInverse) {
+    const uint32_t half = mSize / 2;
+    float* re = mReal.data();
+    float* im = mImag.data();
+    const uint32_t* bitReverse = mTables->bitReverse.data();
+    const float* cosTable = mTables->cos.data();
+    const float* sinTable = mTables->sin.data();
+
+    for (uint32_t i = 0; i < half; ++i) {
+        const uint32_t j = bitReverse[i];
+        if (j > i) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+
+    const float sign = inInverse ? -1.0f : 1.0f;
+    for (uint32_t length = 2; length <= half; length <<= 1) {
+        const uint32_t step = half / length;
+        const uint32_t span = length / 2;
+        for (uint32_t start = 0; start < half; start += length) {
+            for (uint32_t i = 0; i < span; ++i) {
+                const float wr = cosTable[i * step];
+                const float wi = sign * sinTable[i * step];
+                const uint32_t a = start + i;
+                const uint32_t b = a + span;
+                const float tr = re[b] * wr - im[b] * wi;
+                const float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+// Even samples in the real part, odd in the imaginary, then untangle:
+// X[k] = E[k] + W^k O[k]
+void Fft::Forward(const float* inInput, float* outReal, float* outImag) {
+    const uint32_t half = mSize / 2;
+    for (uint32_t i = 0; i < half; ++i) {
+        mReal[i] = inInput[2 * i];
+        mImag[i] = inInput[2 * i + 1];
+    }
+    Transform(false);
+
+    for (uint32_t k = 0; k <= half; ++k) {
+        const uint32_t a = (k == half) ? 0 : k;
+        const uint32_t b = (k == 0) ? 0 : half - k;
+        const float evenRe = 0.5f * (mReal[a] + mReal[b]);
+        const float evenIm = 0.5f * (mImag[a] - mImag[b]);
+        const float oddRe = 0.5f * (mImag[a] + mImag[b]);
+        const float oddIm = -0.5f * (mReal[a] - mReal[b]);
+        const float wr = mTables->splitCos[k];
+        const float wi = mTables->splitSin[k];
+        outReal[k] = evenRe + wr * oddRe - wi * oddIm;
+        outImag[k] = evenIm + wr * oddIm + wi * oddRe;
+    }
+}
+
+// E[k] = (X[k] + X*[M-k]) / 2, O[k] = (X[k] - X*[M-k]) / (2 W^k), then
+// z = E + iO through the half-size inverse
+void Fft::Inverse(const float* inReal, const float* inImag, float* outOutput) {
+    const uint32_t half = mSize / 2;
+    for (uint32_t k = 0; k < half; ++k) {
+        const uint32_t m = half - k;
+        const float evenRe = 0.5f * (inReal[k] + inReal[m]);
+        const float evenIm = 0.5f * (inImag[k] - inImag[m]);
+        const float diffRe = 0.5f * (inReal[k] - inReal[m]);
+        const float diffIm = 0.5f * (inImag[k] + inImag[m]);
+
+        // Divide by W^k: multiply by its conjugate
+        const float wr = mTables->splitCos[k];
+        const float wi = -mTables->splitSin[k];
+        const float oddRe = diffRe * wr - diffIm * wi;
+        const float oddIm = diffRe * wi + diffIm * wr;
+
+        mReal[k] = evenRe - oddIm;
+        mImag[k] = evenIm + oddRe;
+    }
+    Transform(true);
+
+    const float scale = 1.0f / half;
+    for (uint32_t i = 0; i < half; ++i) {
+        outOutput[2 * i] = mReal[i] * scale;
+        outOutput[2 * i + 1] = mImag[i] * scale;
+    }
+}
@@ -0,0 +1,50 @@
+// Standard library headers
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Include guards
+#ifndef __Fft_h__
+#define __Fft_h__
+
+// Twiddle and bit-reversal tables for one transform size, shared by every
+// Fft of that size in the process
+struct FftTables
+{
+    std::vector<uint32_t> bitReverse;
+    std::vector<float> cos;           // Twiddles for the half-size transform
+    std::vector<float> sin;
+    std::vector<float> splitCos;      // Twiddles for the real split pass
+    std::vector<float> splitSin;
+};
+
+// Real-input radix-2 FFT. A size-N transform runs as one complex FFT of N/2
+// points plus a split pass, on split real/imaginary arrays of N/2 + 1 bins.
+// Tables are looked up in Prepare(), built only by the first Fft of a size;
+// the transforms never allocate.
+class Fft
+{
+public:
+    Fft();
+
+    // inSize must be a power of two, at least 4
+    void Prepare(uint32_t inSize);
+    uint32_t GetSize() const { return mSize; }
+
+    // inInput holds GetSize() samples; outReal/outImag get GetSize()/2 + 1 bins
+    void Forward(const float* inInput, float* outReal, float* outImag);
+
+    // Exact inverse of Forward(), including the 1/N scale
+    void Inverse(const float* inReal, const float* inImag, float* outOutput);
+
+private:
+    // In-place complex FFT of mSize / 2 points on mReal/mImag
+    void Transform(bool inInverse);
+
+    uint32_t mSize;
+    std::shared_ptr<const FftTables> mTables;
+    std::vector<float> mReal;          // Half-size complex work buffer
+    std::vector<float> mImag;
+};
+
+#endif /* __Fft_h__ */
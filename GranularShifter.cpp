@@ -0,0 +1,202 @@
+#include "GranularShifter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Nominal delay; the tap sweeps around it
+const double kLatencySeconds = 0.004;
+
+// Longest splice crossfade, and the stretch of recent input compared when
+// choosing where to splice
+const double kMaxFadeSeconds = 0.002;
+const double kCorrelationSeconds = 0.0015;
+
+// Frames the cubic interpolator needs on either side of the read position
+const uint32_t kInterpolationMargin = 2;
+
+// Catmull-Rom interpolation between y1 and y2
+inline float Interpolate(float y0, float y1, float y2, float y3, float inFraction) {
+    const float c1 = 0.5f * (y2 - y0);
+    const float c2 = y0 - 2.5f * y1 + 2.0f * y2 - 0.5f * y3;
+    const float c3 = 0.5f * (y3 - y0) + 1.5f * (y1 - y2);
+    return ((c3 * inFraction + c2) * inFraction + c1) * inFraction + y1;
+}
+
+// Reads one channel inDelay frames before inWritePosition (the newest frame)
+inline float ReadTap(const float* inLine, uint32_t inMask, uint32_t inWritePosition, double inDelay) {
+    const double position = static_cast<double>(inWritePosition) - inDelay;
+    const double whole = std::floor(position);
+    const uint32_t index = static_cast<uint32_t>(static_cast<int64_t>(whole)) & inMask;
+    return Interpolate(inLine[(index - 1) & inMask], inLine[index], inLine[(index + 1) & inMask],
+                       inLine[(index + 2) & inMask], static_cast<float>(position - whole));
+}
+
+} // namespace
+
+// Constructor
+GranularShifter::GranularShifter()
+    : mDelayFrames(0),
+      mDelayMask(0),
+      mWritePosition(0),
+      mDelay(0.0),
+      mSpan(0.0),
+      mFadeDelay(0.0),
+      mFadeFrames(0),
+      mFadePosition(0),
+      mLatencyFrames(0),
+      mMaxFadeFrames(0),
+      mCorrelationFrames(0),
+      mSearchStep(1),
+      mNumChannels(0),
+      mPitchScale(1.0)
+{
+}
+
+void GranularShifter::Prepare(double inSampleRate, uint32_t inNumChannels) {
+    mNumChannels = inNumChannels;
+    mLatencyFrames = std::max(4 * kInterpolationMargin, static_cast<uint32_t>(kLatencySeconds * inSampleRate));
+    mMaxFadeFrames = std::max<uint32_t>(1, static_cast<uint32_t>(kMaxFadeSeconds * inSampleRate));
+    mCorrelationFrames = std::max<uint32_t>(1, static_cast<uint32_t>(kCorrelationSeconds * inSampleRate));
+
+    // Search about one candidate per 48 kHz frame regardless of rate
+    mSearchStep = std::max<uint32_t>(1, static_cast<uint32_t>(inSampleRate / 48000.0));
+
+    // Longest delay a tap reaches, plus the frames compared behind it
+    const uint32_t maxDelay = 2 * mLatencyFrames + mCorrelationFrames + 2 * kInterpolationMargin;
+    mDelayFrames = 1;
+    while (mDelayFrames < maxDelay) {
+        mDelayFrames <<= 1;
+    }
+    mDelayMask = mDelayFrames - 1;
+    mDelayLine.assign(static_cast<size_t>(inNumChannels) * mDelayFrames, 0.0f);
+
+    Reset();
+}
+
+void GranularShifter::Reset() {
+    std::fill(mDelayLine.begin(), mDelayLine.end(), 0.0f);
+    mWritePosition = 0;
+    mDelay = mLatencyFrames;
+    mSpan = 2.0 * (mLatencyFrames - kInterpolationMargin);
+    mFadeDelay = mDelay;
+    mFadeFrames = 0;
+    mFadePosition = 0;
+}
+
+// Maximise the normalised correlation of the recent input behind the tap
+// with the input one span further along the splice direction. The peak is
+// refined to a fractional span, since a whole-frame error on every splice
+// adds up to an audible detune.
+double GranularShifter::FindSpliceSpan(double inDelay, double inDirection, uint32_t inMinSpan,
+                                       uint32_t inMaxSpan) const {
+    const uint32_t base = static_cast<uint32_t>(static_cast<int64_t>(std::floor(mWritePosition - inDelay)));
+
+    auto correlation = [&](uint32_t inSpan) {
+        const uint32_t other = base - static_cast<uint32_t>(static_cast<int64_t>(inDirection * inSpan));
+        double cross = 0.0;
+        double energyA = 0.0;
+        double energyB = 0.0;
+        for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+            const float* line = mDelayLine.data() + static_cast<size_t>(channel) * mDelayFrames;
+            for (uint32_t frame = 0; frame < mCorrelationFrames; ++frame) {
+                const float a = line[(base - frame) & mDelayMask];
+                const float b = line[(other - frame) & mDelayMask];
+                cross += a * b;
+                energyA += a * a;
+                energyB += b * b;
+            }
+        }
+        return (energyA > 0.0 && energyB > 0.0) ? cross / std::sqrt(energyA * energyB) : 0.0;
+    };
+
+    double bestScore = -2.0;
+    uint32_t bestSpan = inMaxSpan;
+    for (uint32_t span = inMinSpan; span <= inMaxSpan; span += mSearchStep) {
+        const double score = correlation(span);
+        if (score > bestScore) {
+            bestScore = score;
+            bestSpan = span;
+        }
+    }
+
+    // Parabolic fit through the neighbours (only inside the searched range)
+    if (bestSpan < inMinSpan + 1 || bestSpan + 1 > inMaxSpan) {
+        return bestSpan;
+    }
+    const double before = correlation(bestSpan - 1);
+    const double after = correlation(bestSpan + 1);
+    const double curvature = before - 2.0 * bestScore + after;
+    if (curvature >= 0.0) {
+        return bestSpan;
+    }
+    return bestSpan + std::clamp(0.5 * (before - after) / curvature, -0.5, 0.5);
+}
+
+void GranularShifter::Process(const float* const* inInputs, float* const* outOutputs, uint32_t inFrames) {
+    const double latency = mLatencyFrames;
+    const double usable = latency - kInterpolationMargin;
+
+    for (uint32_t frame = 0; frame < inFrames; ++frame) {
+        for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+            mDelayLine[static_cast<size_t>(channel) * mDelayFrames + mWritePosition] = inInputs[channel][frame];
+        }
+
+        // Shifting up the delay shrinks by (ratio - 1) per frame, shifting
+        // down it grows; at unison the tap stands still at the latency
+        const double rate = 1.0 - mPitchScale;
+        const double speed = std::fabs(rate);
+
+        // Splice before the fading tap would run past its end of the sweep
+        if (mFadeFrames == 0 && speed > 0.0) {
+            const uint32_t fadeFrames = std::min<uint32_t>(
+                mMaxFadeFrames, static_cast<uint32_t>(2.0 * usable / (3.0 * speed)));
+            const double fadeTravel = fadeFrames * speed;
+            const double limit = 0.5 * mSpan - 0.5 * fadeTravel;
+            const bool atEnd = (rate < 0.0) ? (mDelay <= latency - limit) : (mDelay >= latency + limit);
+
+            if (atEnd && fadeFrames > 0) {
+                // Jump back against the sweep by a span matching the waveform
+                const double direction = (rate < 0.0) ? 1.0 : -1.0;
+                const uint32_t maxSpan = static_cast<uint32_t>(2.0 * usable - fadeTravel);
+                const uint32_t minSpan = std::min(maxSpan, static_cast<uint32_t>(fadeTravel) + mSearchStep);
+                const double span = FindSpliceSpan(mDelay, direction, minSpan, maxSpan);
+
+                mFadeDelay = mDelay;
+                mDelay = std::clamp(mDelay + direction * span, static_cast<double>(kInterpolationMargin),
+                                    2.0 * latency);
+                mSpan = span;
+                mFadeFrames = fadeFrames;
+                mFadePosition = 0;
+            }
+        }
+
+        float fadeGain = 0.0f;
+        if (mFadeFrames > 0) {
+            const float position = static_cast<float>(mFadePosition) / mFadeFrames;
+            fadeGain = 0.5f + 0.5f * std::cos(static_cast<float>(M_PI) * position);
+        }
+
+        for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+            const float* line = mDelayLine.data() + static_cast<size_t>(channel) * mDelayFrames;
+            float sample = ReadTap(line, mDelayMask, mWritePosition, mDelay);
+            if (mFadeFrames > 0) {
+                const float fading = ReadTap(line, mDelayMask, mWritePosition, mFadeDelay);
+                sample += fadeGain * (fading - sample);
+            }
+            outOutputs[channel][frame] = sample;
+        }
+
+        // Advance both taps; the bounds only matter if the ratio jumps
+        // mid-sweep
+        mDelay = std::clamp(mDelay + rate, static_cast<double>(kInterpolationMargin), 2.0 * latency);
+        if (mFadeFrames > 0) {
+            mFadeDelay = std::clamp(mFadeDelay + rate, static_cast<double>(kInterpolationMargin), 2.0 * latency);
+            if (++mFadePosition == mFadeFrames) {
+                mFadeFrames = 0;
+            }
+        }
+
+        mWritePosition = (mWritePosition + 1) & mDelayMask;
+    }
+}
@@ -0,0 +1,60 @@
+// Standard library headers
+#include <cstdint>
+#include <vector>
+
+// Include guards
+#ifndef __GranularShifter_h__
+#define __GranularShifter_h__
+
+// Time-domain pitch shifter for live monitoring. A read tap sweeps a short
+// delay line at the pitch ratio; when it nears either end it is spliced back
+// by a span chosen to match the waveform (the best-correlated offset, which
+// for pitched input is a whole number of periods) and crossfaded. The sweep
+// is centred on GetLatencyFrames(), so at unison the output is the input
+// delayed by exactly that, and the delay stays under 5 ms at any sample
+// rate. Formants move with the pitch.
+//
+// All storage is allocated in Prepare(); Process() never allocates.
+class GranularShifter
+{
+public:
+    GranularShifter();
+
+    void Prepare(double inSampleRate, uint32_t inNumChannels);
+    void Reset();
+
+    void SetPitchScale(double inPitchScale) { mPitchScale = inPitchScale; }
+
+    // inInputs and outOutputs hold GetNumChannels() buffers and may alias
+    void Process(const float* const* inInputs, float* const* outOutputs, uint32_t inFrames);
+
+    uint32_t GetNumChannels() const { return mNumChannels; }
+    uint32_t GetLatencyFrames() const { return mLatencyFrames; }
+
+private:
+    // Picks the splice span for a tap at inDelay, in [inMinSpan, inMaxSpan]
+    double FindSpliceSpan(double inDelay, double inDirection, uint32_t inMinSpan, uint32_t inMaxSpan) const;
+
+    // Delay line, one power-of-two ring per channel
+    std::vector<float> mDelayLine;
+    uint32_t mDelayFrames;
+    uint32_t mDelayMask;
+    uint32_t mWritePosition;
+
+    // The tap being heard, and the one it fades out from during a splice
+    double mDelay;
+    double mSpan;                 // Sweep span the current tap was spliced with
+    double mFadeDelay;
+    uint32_t mFadeFrames;         // Length of the running splice, 0 when idle
+    uint32_t mFadePosition;
+
+    // Fixed at Prepare()
+    uint32_t mLatencyFrames;
+    uint32_t mMaxFadeFrames;
+    uint32_t mCorrelationFrames;
+    uint32_t mSearchStep;
+    uint32_t mNumChannels;
+    double mPitchScale;
+};
+
+#endif /* __GranularShifter_h__ */
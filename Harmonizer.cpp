@@ -0,0 +1,315 @@
+#include "Harmonizer.h"
+#include "SharedCache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Analysis hops per window. With a Hann window on analysis and synthesis,
+// four hops overlap-add to a constant 1.5.
+const uint32_t kOverlap = 4;
+const float kOverlapGain = 1.0f / 1.5f;
+
+// Bins below this fraction of the frame's loudest bin are not peaks
+const float kPeakFloor = 1.0e-4f;
+
+const double kTwoPi = 2.0 * M_PI;
+
+// Hann windows by size, shared by every harmonizer in the process
+SharedCache<uint32_t, std::vector<float>> sWindows;
+
+// Wraps a phase to [-pi, pi]
+inline double WrapPhase(double inPhase) {
+    return inPhase - kTwoPi * std::floor(inPhase / kTwoPi + 0.5);
+}
+
+} // namespace
+
+// Constructor
+Harmonizer::Harmonizer()
+    : mKernels(GetAudioKernels()),
+      mNumInputChannels(0),
+      mNumOutputChannels(0),
+      mFftSize(0),
+      mHopFrames(0),
+      mNumBins(0),
+      mInputPosition(0),
+      mHopPosition(0),
+      mActiveVoices(),
+      mNumActiveVoices(0),
+      mPitchScale(1.0)
+{
+}
+
+void Harmonizer::Prepare(double /*inSampleRate*/, uint32_t inNumInputChannels, uint32_t inNumOutputChannels,
+                         uint32_t inFftSize) {
+    mNumInputChannels = inNumInputChannels;
+    mNumOutputChannels = inNumOutputChannels;
+    mFftSize = inFftSize;
+    mHopFrames = inFftSize / kOverlap;
+    mNumBins = inFftSize / 2 + 1;
+
+    mWindow = sWindows.Get(inFftSize, [inFftSize] {
+        std::vector<float> window(inFftSize);
+        for (uint32_t i = 0; i < inFftSize; ++i) {
+            window[i] = static_cast<float>(0.5 - 0.5 * cos(kTwoPi * i / inFftSize));
+        }
+        return window;
+    });
+
+    const size_t channelBins = static_cast<size_t>(inNumInputChannels) * mNumBins;
+    mInput.assign(static_cast<size_t>(inNumInputChannels) * inFftSize, 0.0f);
+    mFft.Prepare(inFftSize);
+    mFrame.assign(inFftSize, 0.0f);
+    mReal.assign(mNumBins, 0.0f);
+    mImag.assign(mNumBins, 0.0f);
+    mMagnitude.assign(channelBins, 0.0f);
+    mPhase.assign(channelBins, 0.0f);
+    mPreviousPhase.assign(channelBins, 0.0f);
+    mFrequency.assign(channelBins, 0.0f);
+    mPeaks.assign(channelBins, 0);
+    mRegions.assign(channelBins, 0);
+    mNumPeaks.assign(inNumInputChannels, 0);
+
+    mVoices.resize(kMaxVoices);
+    for (Voice& voice : mVoices) {
+        voice.fft.Prepare(inFftSize);
+        voice.real.assign(mNumBins, 0.0f);
+        voice.imag.assign(mNumBins, 0.0f);
+        voice.phase.assign(channelBins, 0.0f);
+        voice.nextPhase.assign(channelBins, 0.0f);
+        voice.frame.assign(static_cast<size_t>(inNumInputChannels) * inFftSize, 0.0f);
+        UpdateGains(voice);
+    }
+
+    mAccumulator.assign(static_cast<size_t>(inNumOutputChannels) * inFftSize, 0.0f);
+    mOutput.assign(static_cast<size_t>(inNumOutputChannels) * mHopFrames, 0.0f);
+
+    Reset();
+}
+
+void Harmonizer::Reset() {
+    std::fill(mInput.begin(), mInput.end(), 0.0f);
+    std::fill(mPreviousPhase.begin(), mPreviousPhase.end(), 0.0f);
+    std::fill(mAccumulator.begin(), mAccumulator.end(), 0.0f);
+    std::fill(mOutput.begin(), mOutput.end(), 0.0f);
+    for (Voice& voice : mVoices) {
+        voice.fresh = true;
+    }
+    mInputPosition = 0;
+    mHopPosition = 0;
+}
+
+void Harmonizer::SetVoices(const HarmonyVoice* inVoices, uint32_t inNumVoices) {
+    mNumActiveVoices = 0;
+    for (uint32_t i = 0; i < mVoices.size(); ++i) {
+        Voice& voice = mVoices[i];
+        const bool active = i < inNumVoices;
+        if (active) {
+            voice.settings = inVoices[i];
+            UpdateGains(voice);
+            mActiveVoices[mNumActiveVoices++] = i;
+        }
+
+        // A voice coming back starts its phases from the analysis again
+        if (active && !voice.active) {
+            voice.fresh = true;
+        }
+        voice.active = active;
+    }
+}
+
+// Level and pan to per-output gains
+void Harmonizer::UpdateGains(Voice& ioVoice) const {
+    const float level = ioVoice.settings.level;
+    const float pan = std::clamp(ioVoice.settings.pan, -1.0f, 1.0f);
+    if (mNumOutputChannels < 2) {
+        ioVoice.gains[0] = level;
+        ioVoice.gains[1] = level;
+    } else if (mNumInputChannels < 2) {
+        const float angle = (pan + 1.0f) * static_cast<float>(M_PI / 4.0);
+        ioVoice.gains[0] = level * std::cos(angle);
+        ioVoice.gains[1] = level * std::sin(angle);
+    } else {
+        ioVoice.gains[0] = level * std::min(1.0f, 1.0f - pan);
+        ioVoice.gains[1] = level * std::min(1.0f, 1.0f + pan);
+    }
+}
+
+// Queue input, play out the finished hop, and run a frame at every hop
+// boundary
+bool Harmonizer::Process(const float* const* inInputs, float* const* outOutputs, uint32_t inFrames,
+                         RenderWorkerPool* inPool) {
+    const uint32_t mask = mFftSize - 1;
+    for (uint32_t done = 0; done < inFrames; ) {
+        const uint32_t frames = std::min(inFrames - done, mHopFrames - mHopPosition);
+
+        const uint32_t first = std::min(frames, mFftSize - mInputPosition);
+        for (uint32_t channel = 0; channel < mNumInputChannels; ++channel) {
+            float* input = mInput.data() + static_cast<size_t>(channel) * mFftSize;
+            memcpy(input + mInputPosition, inInputs[channel] + done, first * sizeof(float));
+            memcpy(input, inInputs[channel] + done + first, (frames - first) * sizeof(float));
+        }
+        mInputPosition = (mInputPosition + frames) & mask;
+
+        for (uint32_t channel = 0; channel < mNumOutputChannels; ++channel) {
+            memcpy(outOutputs[channel] + done, mOutput.data() + static_cast<size_t>(channel) * mHopFrames + mHopPosition,
+                   frames * sizeof(float));
+        }
+
+        mHopPosition += frames;
+        done += frames;
+        if (mHopPosition == mHopFrames) {
+            if (!ProcessFrame(inPool)) {
+                return false;
+            }
+            mHopPosition = 0;
+        }
+    }
+    return true;
+}
+
+bool Harmonizer::ProcessFrame(RenderWorkerPool* inPool) {
+    for (uint32_t channel = 0; channel < mNumInputChannels; ++channel) {
+        Analyze(channel);
+    }
+
+    if (inPool && mNumActiveVoices > 1) {
+        if (!inPool->Run(&Harmonizer::SynthesizeTask, this, mNumActiveVoices)) {
+            return false;
+        }
+    } else {
+        for (uint32_t i = 0; i < mNumActiveVoices; ++i) {
+            Synthesize(mVoices[mActiveVoices[i]]);
+        }
+    }
+
+    // Overlap-add; outputs beyond the input channels take the last one
+    for (uint32_t channel = 0; channel < mNumOutputChannels; ++channel) {
+        float* accumulator = mAccumulator.data() + static_cast<size_t>(channel) * mFftSize;
+        const uint32_t source = std::min(channel, mNumInputChannels - 1);
+        for (uint32_t i = 0; i < mNumActiveVoices; ++i) {
+            const Voice& voice = mVoices[mActiveVoices[i]];
+            const float* frame = voice.frame.data() + static_cast<size_t>(source) * mFftSize;
+            mKernels.Accumulate(frame, accumulator, voice.gains[std::min<uint32_t>(channel, 1)], mFftSize);
+        }
+
+        // The oldest hop is complete
+        memcpy(mOutput.data() + static_cast<size_t>(channel) * mHopFrames, accumulator, mHopFrames * sizeof(float));
+        memmove(accumulator, accumulator + mHopFrames, (mFftSize - mHopFrames) * sizeof(float));
+        std::fill_n(accumulator + mFftSize - mHopFrames, mHopFrames, 0.0f);
+    }
+    return true;
+}
+
+// Magnitude, phase and true frequency of every bin, and the peaks with the
+// region of bins each one carries
+void Harmonizer::Analyze(uint32_t inChannel) {
+    const uint32_t mask = mFftSize - 1;
+    const float* input = mInput.data() + static_cast<size_t>(inChannel) * mFftSize;
+    const float* window = mWindow->data();
+    for (uint32_t n = 0; n < mFftSize; ++n) {
+        mFrame[n] = input[(mInputPosition + n) & mask] * window[n];
+    }
+    mFft.Forward(mFrame.data(), mReal.data(), mImag.data());
+
+    const size_t base = static_cast<size_t>(inChannel) * mNumBins;
+    float* magnitude = mMagnitude.data() + base;
+    float* phase = mPhase.data() + base;
+    float* previousPhase = mPreviousPhase.data() + base;
+    float* frequency = mFrequency.data() + base;
+    const double binAdvance = kTwoPi * mHopFrames / mFftSize;
+
+    float loudest = 0.0f;
+    for (uint32_t k = 0; k < mNumBins; ++k) {
+        magnitude[k] = std::hypot(mReal[k], mImag[k]);
+        phase[k] = std::atan2(mImag[k], mReal[k]);
+        const double deviation = WrapPhase(phase[k] - previousPhase[k] - k * binAdvance);
+        frequency[k] = static_cast<float>(k + deviation / binAdvance);
+        previousPhase[k] = phase[k];
+        loudest = std::max(loudest, magnitude[k]);
+    }
+
+    // Local maxima over two bins either side; each region starts halfway
+    // from the previous peak
+    uint32_t* peaks = mPeaks.data() + base;
+    uint32_t* regions = mRegions.data() + base;
+    uint32_t numPeaks = 0;
+    const float floor = loudest * kPeakFloor;
+    for (uint32_t k = 2; k + 2 < mNumBins; ++k) {
+        const float m = magnitude[k];
+        if (m > floor && m > magnitude[k - 1] && m >= magnitude[k + 1] && m > magnitude[k - 2] &&
+            m >= magnitude[k + 2]) {
+            regions[numPeaks] = (numPeaks == 0) ? 0 : (peaks[numPeaks - 1] + k + 1) / 2;
+            peaks[numPeaks++] = k;
+        }
+    }
+    mNumPeaks[inChannel] = numPeaks;
+}
+
+// Move every peak region to the voice's ratio, advance the peak's phase at
+// its new frequency and rotate the region's bins with it
+void Harmonizer::Synthesize(Voice& ioVoice) {
+    const double ratio = mPitchScale * pow(2.0, ioVoice.settings.interval / 12.0);
+    const double hopAdvance = kTwoPi * mHopFrames / mFftSize;
+
+    for (uint32_t channel = 0; channel < mNumInputChannels; ++channel) {
+        const size_t base = static_cast<size_t>(channel) * mNumBins;
+        const float* magnitude = mMagnitude.data() + base;
+        const float* phase = mPhase.data() + base;
+        const float* frequency = mFrequency.data() + base;
+        const uint32_t* peaks = mPeaks.data() + base;
+        const uint32_t* regions = mRegions.data() + base;
+        const uint32_t numPeaks = mNumPeaks[channel];
+        const float* synthesisPhase = ioVoice.phase.data() + base;
+        float* nextPhase = ioVoice.nextPhase.data() + base;
+
+        std::fill(ioVoice.real.begin(), ioVoice.real.end(), 0.0f);
+        std::fill(ioVoice.imag.begin(), ioVoice.imag.end(), 0.0f);
+        std::copy_n(synthesisPhase, mNumBins, nextPhase);
+
+        for (uint32_t i = 0; i < numPeaks; ++i) {
+            const uint32_t peak = peaks[i];
+            const int64_t target = std::llround(peak * ratio);
+            if (target >= mNumBins - 1) {
+                break;
+            }
+            if (target < 1) {
+                continue;
+            }
+            const int64_t shift = target - peak;
+
+            const double peakPhase = ioVoice.fresh ? phase[peak] :
+                WrapPhase(synthesisPhase[target] + hopAdvance * frequency[peak] * ratio);
+            const double rotation = peakPhase - phase[peak];
+
+            const uint32_t end = (i + 1 < numPeaks) ? regions[i + 1] : mNumBins;
+            for (uint32_t k = regions[i]; k < end; ++k) {
+                const int64_t bin = k + shift;
+                if (bin < 0 || bin >= mNumBins) {
+                    continue;
+                }
+                const double binPhase = phase[k] + rotation;
+                ioVoice.real[bin] += magnitude[k] * static_cast<float>(std::cos(binPhase));
+                ioVoice.imag[bin] += magnitude[k] * static_cast<float>(std::sin(binPhase));
+                nextPhase[bin] = static_cast<float>(WrapPhase(binPhase));
+            }
+        }
+
+        float* frame = ioVoice.frame.data() + static_cast<size_t>(channel) * mFftSize;
+        ioVoice.fft.Inverse(ioVoice.real.data(), ioVoice.imag.data(), frame);
+        const float* window = mWindow->data();
+        for (uint32_t n = 0; n < mFftSize; ++n) {
+            frame[n] *= window[n] * kOverlapGain;
+        }
+    }
+
+    ioVoice.phase.swap(ioVoice.nextPhase);
+    ioVoice.fresh = false;
+}
+
+void Harmonizer::SynthesizeTask(void* inContext, uint32_t inIndex) {
+    Harmonizer* harmonizer = static_cast<Harmonizer*>(inContext);
+    harmonizer->Synthesize(harmonizer->mVoices[harmonizer->mActiveVoices[inIndex]]);
+}
@@ -0,0 +1,128 @@
+// Standard library headers
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AudioKernels.h"
+#include "Fft.h"
+#include "RenderWorkerPool.h"
+
+// Include guards
+#ifndef __Harmonizer_h__
+#define __Harmonizer_h__
+
+// One harmony voice: a transposition on top of the global pitch scale, a
+// gain, and a position in the stereo output
+struct HarmonyVoice
+{
+    double interval = 0.0;   // Semitones
+    float level = 1.0f;      // Linear gain
+    float pan = 0.0f;        // -1 (left) to 1 (right)
+};
+
+// Phase-vocoder harmonizer. Every hop, each input channel is analysed once
+// (magnitude, phase and true frequency per bin, plus the spectral peaks);
+// each voice then shifts the shared analysis by its own ratio, moving every
+// peak with the bins around it and keeping their phase relationships
+// (Laroche-Dolson), and resynthesizes with its own inverse FFT. The voices
+// are independent, so with a RenderWorkerPool they run in parallel.
+//
+// Voices are summed into the output channels with their level and pan: a
+// mono source is panned at constant power, a stereo source is balanced, a
+// mono output ignores pan. Voice changes take effect on the next hop, and
+// overlap-add smooths them over one window.
+//
+// Sample-synchronous with a delay of exactly GetLatencyFrames() (one FFT
+// window). All storage is allocated in Prepare(); Process() never allocates.
+class Harmonizer
+{
+public:
+    static const uint32_t kMaxVoices = 8;
+
+    Harmonizer();
+
+    // inFftSize must be a power of two; the hop is a quarter of it
+    void Prepare(double inSampleRate, uint32_t inNumInputChannels, uint32_t inNumOutputChannels, uint32_t inFftSize);
+    void Reset();
+
+    // Global transposition, applied to every voice
+    void SetPitchScale(double inPitchScale) { mPitchScale = inPitchScale; }
+
+    // The first inNumVoices (<= kMaxVoices) voices sound; the rest are off
+    void SetVoices(const HarmonyVoice* inVoices, uint32_t inNumVoices);
+
+    // inInputs holds GetNumInputChannels() buffers, outOutputs
+    // GetNumOutputChannels(); they must not alias. False when a voice on the
+    // pool missed its deadline: the output is incomplete and the harmonizer
+    // must be left alone until the pool is idle, then Reset().
+    bool Process(const float* const* inInputs, float* const* outOutputs, uint32_t inFrames,
+                 RenderWorkerPool* inPool = nullptr);
+
+    uint32_t GetNumInputChannels() const { return mNumInputChannels; }
+    uint32_t GetNumOutputChannels() const { return mNumOutputChannels; }
+    uint32_t GetLatencyFrames() const { return mFftSize; }
+
+private:
+    struct Voice
+    {
+        Fft fft;
+        std::vector<float> real;          // Shifted spectrum, one channel at a time
+        std::vector<float> imag;
+        std::vector<float> phase;         // Synthesis phase per bin and channel
+        std::vector<float> nextPhase;
+        std::vector<float> frame;         // Windowed output frame per channel
+        HarmonyVoice settings;
+        float gains[2] = { 0.0f, 0.0f };  // Per output channel, fixed for one hop
+        bool active = false;
+        bool fresh = true;                // No synthesis phase yet
+    };
+
+    // One hop: analyse every channel, synthesize every active voice, then
+    // overlap-add the voices into the output; false as for Process()
+    bool ProcessFrame(RenderWorkerPool* inPool);
+    void Analyze(uint32_t inChannel);
+    void Synthesize(Voice& ioVoice);
+    static void SynthesizeTask(void* inContext, uint32_t inIndex);
+    void UpdateGains(Voice& ioVoice) const;
+
+    const AudioKernels& mKernels;
+
+    // Fixed at Prepare()
+    uint32_t mNumInputChannels;
+    uint32_t mNumOutputChannels;
+    uint32_t mFftSize;
+    uint32_t mHopFrames;
+    uint32_t mNumBins;
+    std::shared_ptr<const std::vector<float>> mWindow;  // Shared between instances
+
+    // Input ring of one window per channel, and the position in the hop
+    std::vector<float> mInput;
+    uint32_t mInputPosition;
+    uint32_t mHopPosition;
+
+    // Shared analysis, per channel and bin
+    Fft mFft;
+    std::vector<float> mFrame;
+    std::vector<float> mReal;
+    std::vector<float> mImag;
+    std::vector<float> mMagnitude;
+    std::vector<float> mPhase;
+    std::vector<float> mPreviousPhase;
+    std::vector<float> mFrequency;      // True frequency, in bins
+    std::vector<uint32_t> mPeaks;       // Peak bins, ascending
+    std::vector<uint32_t> mRegions;     // First bin each peak's region starts at
+    std::vector<uint32_t> mNumPeaks;
+
+    // Voices, and the active ones for the current hop
+    std::vector<Voice> mVoices;
+    uint32_t mActiveVoices[kMaxVoices];
+    uint32_t mNumActiveVoices;
+    double mPitchScale;
+
+    // Overlap-add accumulator of one window per output channel, and the hop
+    // of finished output being played out
+    std::vector<float> mAccumulator;
+    std::vector<float> mOutput;
+};
+
+#endif /* __Harmonizer_h__ */
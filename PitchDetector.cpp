@@ -0,0 +1,165 @@
+#include "PitchDetector.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Analysis rate the input is decimated towards, and the anti-alias cutoff
+// as a fraction of it
+const double kAnalysisRate = 12000.0;
+const double kAntiAliasFraction = 0.4;
+
+// YIN threshold on the normalized difference
+const float kThreshold = 0.15f;
+
+// Below this RMS level there is nothing to analyse
+const float kSilentLevel = 1e-5f;
+
+// Folded input processed per pass
+const uint32_t kChunkFrames = 256;
+
+} // namespace
+
+// Constructor
+PitchDetector::PitchDetector()
+    : mKernels(GetAudioKernels()),
+      mNumChannels(0),
+      mDecimation(1),
+      mDecimationPhase(0),
+      mMinLag(2),
+      mMaxLag(2),
+      mWindow(2),
+      mHop(1),
+      mUntilAnalysis(1),
+      mHistoryPosition(0),
+      mPeriodFrames(0.0),
+      mAperiodicity(1.0f),
+      mLevel(0.0f)
+{
+}
+
+void PitchDetector::Prepare(double inSampleRate, uint32_t inNumChannels) {
+    mNumChannels = inNumChannels;
+    mDecimation = std::max<uint32_t>(1, static_cast<uint32_t>(inSampleRate / kAnalysisRate));
+    const double analysisRate = inSampleRate / mDecimation;
+    mAntiAlias.Prepare(inSampleRate, 1, kAntiAliasFraction * analysisRate);
+
+    // The window spans the longest period; the difference function needs
+    // one lag either side of the range for the interpolation
+    mMinLag = std::max<uint32_t>(2, static_cast<uint32_t>(analysisRate / kMaxFrequency));
+    mMaxLag = std::max(mMinLag + 1, static_cast<uint32_t>(std::ceil(analysisRate / kMinFrequency)));
+    mWindow = mMaxLag;
+    mHop = mWindow / 2;
+
+    const uint32_t historyFrames = mWindow + mMaxLag + 1;
+    mHistory.assign(historyFrames, 0.0f);
+    mFrame.assign(historyFrames, 0.0f);
+    mDifference.assign(mMaxLag + 2, 0.0f);
+    mChunk.assign(kChunkFrames, 0.0f);
+
+    Reset();
+}
+
+void PitchDetector::Reset() {
+    mAntiAlias.Reset();
+    std::fill(mHistory.begin(), mHistory.end(), 0.0f);
+    mHistoryPosition = 0;
+    mDecimationPhase = 0;
+    mUntilAnalysis = mHop;
+    mPeriodFrames = 0.0;
+    mAperiodicity = 1.0f;
+    mLevel = 0.0f;
+}
+
+void PitchDetector::Process(const float* const* inInputs, uint32_t inFrames) {
+    const float scale = 1.0f / mNumChannels;
+    const uint32_t historyFrames = static_cast<uint32_t>(mHistory.size());
+    float* chunk = mChunk.data();
+
+    for (uint32_t done = 0; done < inFrames; ) {
+        const uint32_t frames = std::min(inFrames - done, kChunkFrames);
+        for (uint32_t frame = 0; frame < frames; ++frame) {
+            float sum = 0.0f;
+            for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+                sum += inInputs[channel][done + frame];
+            }
+            chunk[frame] = sum * scale;
+        }
+        mAntiAlias.Process(&chunk, frames);
+
+        for (uint32_t frame = 0; frame < frames; ++frame) {
+            if (mDecimationPhase == 0) {
+                mHistory[mHistoryPosition] = chunk[frame];
+                mHistoryPosition = (mHistoryPosition + 1 == historyFrames) ? 0 : mHistoryPosition + 1;
+                if (--mUntilAnalysis == 0) {
+                    mUntilAnalysis = mHop;
+                    Analyze();
+                }
+            }
+            mDecimationPhase = (mDecimationPhase + 1 == mDecimation) ? 0 : mDecimationPhase + 1;
+        }
+        done += frames;
+    }
+}
+
+void PitchDetector::Analyze() {
+    // Oldest first
+    const uint32_t historyFrames = static_cast<uint32_t>(mHistory.size());
+    const uint32_t tail = historyFrames - mHistoryPosition;
+    std::copy(mHistory.begin() + mHistoryPosition, mHistory.end(), mFrame.begin());
+    std::copy(mHistory.begin(), mHistory.begin() + mHistoryPosition, mFrame.begin() + tail);
+
+    float energy = 0.0f;
+    for (float value : mFrame) {
+        energy += value * value;
+    }
+    mLevel = std::sqrt(energy / historyFrames);
+    if (mLevel < kSilentLevel) {
+        mPeriodFrames = 0.0;
+        mAperiodicity = 1.0f;
+        return;
+    }
+
+    // Cumulative mean normalized difference, in place
+    float* difference = mDifference.data();
+    const uint32_t numLags = mMaxLag + 2;
+    mKernels.Difference(mFrame.data(), difference, mWindow, numLags);
+    float sum = 0.0f;
+    difference[0] = 1.0f;
+    for (uint32_t lag = 1; lag < numLags; ++lag) {
+        sum += difference[lag];
+        difference[lag] = (sum > 0.0f) ? difference[lag] * lag / sum : 1.0f;
+    }
+
+    // The first dip under the threshold, followed to its minimum; failing
+    // that the deepest one, which marks the input aperiodic
+    uint32_t best = 0;
+    for (uint32_t lag = mMinLag; lag <= mMaxLag; ++lag) {
+        if (difference[lag] < kThreshold) {
+            while (lag < mMaxLag && difference[lag + 1] < difference[lag]) {
+                ++lag;
+            }
+            best = lag;
+            break;
+        }
+    }
+    if (best == 0) {
+        best = mMinLag;
+        for (uint32_t lag = mMinLag + 1; lag <= mMaxLag; ++lag) {
+            if (difference[lag] < difference[best]) {
+                best = lag;
+            }
+        }
+    }
+
+    const double previous = difference[best - 1];
+    const double current = difference[best];
+    const double next = difference[best + 1];
+    const double curvature = previous - 2.0 * current + next;
+    double offset = 0.0;
+    if (curvature > 0.0) {
+        offset = std::clamp(0.5 * (previous - next) / curvature, -0.5, 0.5);
+    }
+    mPeriodFrames = (best + offset) * mDecimation;
+    mAperiodicity = static_cast<float>(current);
+}
@@ -0,0 +1,81 @@
+// Standard library headers
+#include <cstdint>
+#include <vector>
+
+#include "AudioKernels.h"
+#include "Crossover.h"
+
+// Include guards
+#ifndef __PitchDetector_h__
+#define __PitchDetector_h__
+
+// YIN period detector for single-note material. The input is folded to
+// mono, lowpassed and decimated to about 12 kHz, and every half window the
+// cumulative mean normalized difference of the latest stretch is searched
+// for the first dip below a threshold, refined by parabolic interpolation.
+// The difference function is the AudioKernels Difference kernel, so the
+// analysis costs a few dozen multiply-adds per input frame.
+//
+// GetAperiodicity() is the normalized difference at the chosen lag: near 0
+// for one clean periodic voice, well above the threshold for chords, noise
+// and silence. Results describe the most recent analysis and hold between
+// them.
+//
+// All storage is allocated in Prepare(); Process() never allocates.
+class PitchDetector
+{
+public:
+    // Detectable range
+    static constexpr double kMinFrequency = 60.0;
+    static constexpr double kMaxFrequency = 1000.0;
+
+    PitchDetector();
+
+    void Prepare(double inSampleRate, uint32_t inNumChannels);
+    void Reset();
+
+    // Any number of frames
+    void Process(const float* const* inInputs, uint32_t inFrames);
+
+    // Period in input frames of the last analysis, 0 when it found none
+    double GetPeriodFrames() const { return mPeriodFrames; }
+    float GetAperiodicity() const { return mAperiodicity; }
+
+    // RMS level of the analysed stretch
+    float GetLevel() const { return mLevel; }
+
+    // Longest period that can be reported, in input frames
+    uint32_t GetMaxPeriodFrames() const { return mMaxLag * mDecimation; }
+
+private:
+    void Analyze();
+
+    const AudioKernels& mKernels;
+    ButterworthLowpass mAntiAlias;
+    uint32_t mNumChannels;
+    uint32_t mDecimation;
+    uint32_t mDecimationPhase;
+
+    // Lag range and window, in decimated frames
+    uint32_t mMinLag;
+    uint32_t mMaxLag;
+    uint32_t mWindow;
+    uint32_t mHop;
+    uint32_t mUntilAnalysis;
+
+    // Decimated history ring (window plus every lag), the same unrolled
+    // oldest first for the kernel, and the difference function
+    std::vector<float> mHistory;
+    uint32_t mHistoryPosition;
+    std::vector<float> mFrame;
+    std::vector<float> mDifference;
+
+    // One chunk of folded input
+    std::vector<float> mChunk;
+
+    double mPeriodFrames;
+    float mAperiodicity;
+    float mLevel;
+};
+
+#endif /* __PitchDetector_h__ */
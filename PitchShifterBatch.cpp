@@ -0,0 +1,396 @@
+// Offline batch renderer for the Linux build boxes. Pitch-shifts whole files
+// with RubberBand in offline mode: a study pass over the entire file, then
+// the processing pass, which is as good as RubberBand gets and much faster
+// than the real-time path. Inputs are memory-mapped and output is streamed,
+// so file length does not bound memory; several files render at once on
+// all cores, as many as fit a memory budget.
+//
+// Pitch, formant, stereo mode and mix mean the same as in the plugin (see
+// GetStretcherSettings()). The analysis is always the high quality tier;
+// latency tiers, band split and harmony voices are real-time features and
+// are not available here.
+
+#include "AudioFile.h"
+#include "AudioKernels.h"
+#include "PitchShifterParameters.h"
+#include "StretcherSlot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Rough per-file footprint, for the memory budget: RubberBand's buffers per
+// stretched channel, plus what the study pass keeps for every input hop
+const uint64_t kStretcherBytesPerChannel = 8ull << 20;
+const uint64_t kStudyBytesPerFrame = 1;
+
+const uint32_t kDefaultBlockSize = 4096;
+const uint64_t kDefaultMemoryMegabytes = 2048;
+
+struct BatchJob
+{
+    std::string inputPath;
+    std::string outputPath;
+    uint64_t memoryBytes = 0;
+};
+
+struct BatchConfig
+{
+    float parameters[kNumberOfParameters];
+    uint32_t blockSize = kDefaultBlockSize;
+};
+
+void PrintUsage(const char* inProgram) {
+    fprintf(stderr,
+        "usage: %s [options] input.wav|input.aiff...\n"
+        "  --pitch ST       pitch shift in semitones (default %.0f)\n"
+        "  --formant PCT    formant preservation in percent (default %.0f)\n"
+        "  --mix PCT        dry/wet mix in percent (default %.0f)\n"
+        "  --stereo-mode M  0 independent, 1 mid/side, 2 mono (default %.0f)\n"
+        "  --out-dir DIR    where to write the results (default: next to each input)\n"
+        "  --suffix S       appended to each output name (default \"-shifted\")\n"
+        "  --jobs N         files rendered at once (default: one per core)\n"
+        "  --memory MB      memory budget shared by running files (default %llu)\n"
+        "  --block N        frames per study/process call (default %u)\n"
+        "Outputs are 32-bit float WAV.\n",
+        inProgram, kDefaultPitchShift, kDefaultFormant, kDefaultMix, kDefaultStereoMode,
+        static_cast<unsigned long long>(kDefaultMemoryMegabytes), kDefaultBlockSize);
+}
+
+// "dir/name.aiff" -> "<outDir or dir>/name<suffix>.wav"
+std::string GetOutputPath(const std::string& inInputPath, const std::string& inOutputDirectory,
+                          const std::string& inSuffix) {
+    const size_t slash = inInputPath.find_last_of('/');
+    const std::string directory = (slash == std::string::npos) ? std::string() : inInputPath.substr(0, slash + 1);
+    std::string name = (slash == std::string::npos) ? inInputPath : inInputPath.substr(slash + 1);
+    const size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) {
+        name.resize(dot);
+    }
+    const std::string prefix = inOutputDirectory.empty() ? directory : inOutputDirectory + "/";
+    return prefix + name + inSuffix + ".wav";
+}
+
+// Whether inOutputPath is one of the inputs (say with --suffix ""), which
+// opening it for writing would truncate under the input's memory map
+bool OverwritesInput(const std::string& inOutputPath, const std::vector<BatchJob>& inJobs) {
+    struct stat output;
+    if (stat(inOutputPath.c_str(), &output) != 0) {
+        return false;
+    }
+    for (const BatchJob& job : inJobs) {
+        struct stat input;
+        if (stat(job.inputPath.c_str(), &input) == 0 && input.st_dev == output.st_dev &&
+            input.st_ino == output.st_ino) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t GetNumStretchChannels(const float* inParameters, uint32_t inNumChannels) {
+    return (static_cast<int>(inParameters[kParam_StereoMode]) == kStereoMode_Mono) ? 1 : inNumChannels;
+}
+
+// Reads the header only, to size the file against the memory budget
+bool EstimateMemory(BatchJob& ioJob, const BatchConfig& inConfig, std::string& outError) {
+    MappedAudioFile input;
+    if (!input.Open(ioJob.inputPath, outError)) {
+        return false;
+    }
+    const uint32_t numChannels = input.GetNumChannels();
+    const uint64_t bufferBytes = static_cast<uint64_t>(4 * numChannels) * inConfig.blockSize * sizeof(float);
+    ioJob.memoryBytes = GetNumStretchChannels(inConfig.parameters, numChannels) * kStretcherBytesPerChannel +
+                        input.GetNumFrames() * kStudyBytesPerFrame + bufferBytes;
+    return true;
+}
+
+// Averages every input channel into one, like a kStereoMode_Mono slot
+void FoldToMono(const std::vector<float*>& inChannels, float* outMono, uint32_t inFrames) {
+    const float scale = 1.0f / inChannels.size();
+    for (uint32_t frame = 0; frame < inFrames; ++frame) {
+        float sum = 0.0f;
+        for (const float* channel : inChannels) {
+            sum += channel[frame];
+        }
+        outMono[frame] = sum * scale;
+    }
+}
+
+// Renders one file; outDuration is its length and outSeconds the time it
+// took, both in seconds
+bool RenderFile(const BatchJob& inJob, const BatchConfig& inConfig, double& outDuration, double& outSeconds,
+                std::string& outError) {
+    const auto start = std::chrono::steady_clock::now();
+
+    MappedAudioFile input;
+    if (!input.Open(inJob.inputPath, outError)) {
+        return false;
+    }
+    const double sampleRate = input.GetSampleRate();
+    const uint32_t numChannels = input.GetNumChannels();
+    const uint64_t numFrames = input.GetNumFrames();
+    const uint32_t blockSize = inConfig.blockSize;
+    const float* parameters = inConfig.parameters;
+    outDuration = numFrames / sampleRate;
+
+    // The plugin's high quality tier, switched to offline processing. The
+    // stretcher runs on this thread; the parallelism is across files.
+    StretcherSettings settings = GetStretcherSettings(parameters, numChannels, numChannels,
+                                                      kLatencyMode_HighQuality, false, false);
+    RubberBand::RubberBandStretcher::Options options = settings.options;
+    options &= ~RubberBand::RubberBandStretcher::OptionProcessRealTime;
+    options |= RubberBand::RubberBandStretcher::OptionProcessOffline |
+               RubberBand::RubberBandStretcher::OptionThreadingNever;
+
+    const uint32_t numStretchChannels = GetNumStretchChannels(parameters, numChannels);
+    const double pitchScale = pow(2.0, parameters[kParam_PitchShift] / 12.0);
+    RubberBand::RubberBandStretcher stretcher(static_cast<size_t>(sampleRate), numStretchChannels, options,
+                                              1.0, pitchScale);
+    stretcher.setExpectedInputDuration(numFrames);
+    stretcher.setMaxProcessSize(blockSize);
+
+    // One block each of input, mono fold, wet and output
+    std::vector<float> buffer(static_cast<size_t>(3 * numChannels + 1) * blockSize);
+    std::vector<float*> inputPtrs(numChannels);
+    std::vector<float*> wetPtrs(numStretchChannels);
+    std::vector<float*> outputPtrs(numChannels);
+    float* foldData = buffer.data() + static_cast<size_t>(3 * numChannels) * blockSize;
+    for (uint32_t channel = 0; channel < numChannels; ++channel) {
+        inputPtrs[channel] = buffer.data() + static_cast<size_t>(channel) * blockSize;
+        outputPtrs[channel] = buffer.data() + static_cast<size_t>(numChannels + channel) * blockSize;
+    }
+    for (uint32_t channel = 0; channel < numStretchChannels; ++channel) {
+        wetPtrs[channel] = buffer.data() + static_cast<size_t>(2 * numChannels + channel) * blockSize;
+    }
+    const float* const* stretchInputs = inputPtrs.data();
+    if (numStretchChannels < numChannels) {
+        stretchInputs = &foldData;
+    }
+
+    auto readBlock = [&](uint64_t inPosition, uint32_t inFrames) {
+        input.Read(inputPtrs.data(), inPosition, inFrames);
+        if (numStretchChannels < numChannels) {
+            FoldToMono(inputPtrs, foldData, inFrames);
+        }
+    };
+
+    // Study pass: RubberBand sees the whole file before it renders any of it
+    for (uint64_t position = 0; position < numFrames || position == 0; position += blockSize) {
+        const uint32_t frames = static_cast<uint32_t>(std::min<uint64_t>(blockSize, numFrames - position));
+        readBlock(position, frames);
+        stretcher.study(stretchInputs, frames, position + frames >= numFrames);
+    }
+
+    WavFileWriter output;
+    if (!output.Open(inJob.outputPath, sampleRate, numChannels, outError)) {
+        return false;
+    }
+
+    // Wet frame n lines up with input frame n once the start delay is gone;
+    // the dry signal for the mix is read back from the mapping at n
+    const AudioKernels& kernels = GetAudioKernels();
+    const float wet = parameters[kParam_Mix] / 100.0f;
+    uint32_t delayToDrop = static_cast<uint32_t>(stretcher.getStartDelay());
+    uint64_t written = 0;
+
+    auto writeWet = [&](uint32_t inFrames) -> bool {
+        input.Read(inputPtrs.data(), written, inFrames);
+        for (uint32_t channel = 0; channel < numChannels; ++channel) {
+            const float* wetData = wetPtrs[std::min(channel, numStretchChannels - 1)];
+            if (wet >= 1.0f) {
+                memcpy(outputPtrs[channel], wetData, inFrames * sizeof(float));
+            } else {
+                kernels.Mix(inputPtrs[channel], wetData, outputPtrs[channel], wet, inFrames);
+            }
+        }
+        written += inFrames;
+        return output.Write(outputPtrs.data(), inFrames, outError);
+    };
+
+    auto drain = [&]() -> bool {
+        int available;
+        while (written < numFrames && (available = stretcher.available()) > 0) {
+            const uint32_t frames = static_cast<uint32_t>(std::min<int>(available, blockSize));
+            stretcher.retrieve(wetPtrs.data(), frames);
+
+            const uint32_t dropped = std::min(frames, delayToDrop);
+            delayToDrop -= dropped;
+            const uint32_t kept = static_cast<uint32_t>(std::min<uint64_t>(frames - dropped, numFrames - written));
+            if (kept == 0) {
+                continue;
+            }
+            if (dropped > 0) {
+                for (float* channel : wetPtrs) {
+                    memmove(channel, channel + dropped, kept * sizeof(float));
+                }
+            }
+            if (!writeWet(kept)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Processing pass
+    for (uint64_t position = 0; position < numFrames || position == 0; position += blockSize) {
+        const uint32_t frames = static_cast<uint32_t>(std::min<uint64_t>(blockSize, numFrames - position));
+        readBlock(position, frames);
+        stretcher.process(stretchInputs, frames, position + frames >= numFrames);
+        if (!drain()) {
+            return false;
+        }
+    }
+
+    // A stretcher that ends short leaves silence in the wet signal; the
+    // output always matches the input length
+    while (written < numFrames) {
+        const uint32_t frames = static_cast<uint32_t>(std::min<uint64_t>(blockSize, numFrames - written));
+        for (float* channel : wetPtrs) {
+            std::fill_n(channel, frames, 0.0f);
+        }
+        if (!writeWet(frames)) {
+            return false;
+        }
+    }
+
+    if (!output.Close(outError)) {
+        return false;
+    }
+    outSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BatchConfig config;
+    std::copy_n(kParameterDefaults, kNumberOfParameters, config.parameters);
+    std::string outputDirectory;
+    std::string suffix = "-shifted";
+    unsigned numJobs = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t memoryBudget = kDefaultMemoryMegabytes << 20;
+    std::vector<BatchJob> jobs;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--pitch") == 0 && hasValue) {
+            config.parameters[kParam_PitchShift] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--formant") == 0 && hasValue) {
+            config.parameters[kParam_Formant] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--mix") == 0 && hasValue) {
+            config.parameters[kParam_Mix] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--stereo-mode") == 0 && hasValue) {
+            config.parameters[kParam_StereoMode] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--out-dir") == 0 && hasValue) {
+            outputDirectory = argv[++i];
+        } else if (strcmp(arg, "--suffix") == 0 && hasValue) {
+            suffix = argv[++i];
+        } else if (strcmp(arg, "--jobs") == 0 && hasValue) {
+            numJobs = static_cast<unsigned>(std::max(1, atoi(argv[++i])));
+        } else if (strcmp(arg, "--memory") == 0 && hasValue) {
+            memoryBudget = static_cast<uint64_t>(std::max(1, atoi(argv[++i]))) << 20;
+        } else if (strcmp(arg, "--block") == 0 && hasValue) {
+            config.blockSize = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+        } else if (arg[0] == '-') {
+            PrintUsage(argv[0]);
+            return 1;
+        } else {
+            BatchJob job;
+            job.inputPath = arg;
+            job.outputPath = GetOutputPath(arg, outputDirectory, suffix);
+            jobs.push_back(job);
+        }
+    }
+
+    if (jobs.empty()) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    // The ranges the plugin publishes to the host
+    float* parameters = config.parameters;
+    parameters[kParam_PitchShift] = std::clamp(parameters[kParam_PitchShift], kMinPitchShift, kMaxPitchShift);
+    parameters[kParam_Formant] = std::clamp(parameters[kParam_Formant], kMinFormant, kMaxFormant);
+    parameters[kParam_Mix] = std::clamp(parameters[kParam_Mix], kMinMix, kMaxMix);
+    parameters[kParam_StereoMode] = std::clamp(std::floor(parameters[kParam_StereoMode]), kMinStereoMode, kMaxStereoMode);
+
+    std::atomic<int> numFailed(0);
+    std::vector<BatchJob> runnable;
+    for (BatchJob& job : jobs) {
+        std::string error;
+        if (OverwritesInput(job.outputPath, jobs)) {
+            fprintf(stderr, "%s: output %s would overwrite an input\n", job.inputPath.c_str(), job.outputPath.c_str());
+            ++numFailed;
+        } else if (EstimateMemory(job, config, error)) {
+            runnable.push_back(job);
+        } else {
+            fprintf(stderr, "%s\n", error.c_str());
+            ++numFailed;
+        }
+    }
+
+    // Workers take files in order, each once its estimate fits what is left
+    // of the budget. A file bigger than the whole budget runs on its own.
+    std::mutex mutex;
+    std::condition_variable budgetFreed;
+    size_t nextJob = 0;
+    uint64_t memoryInUse = 0;
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (nextJob < runnable.size()) {
+            const BatchJob& job = runnable[nextJob];
+            if (memoryInUse > 0 && memoryInUse + job.memoryBytes > memoryBudget) {
+                budgetFreed.wait(lock);
+                continue;
+            }
+            ++nextJob;
+            memoryInUse += job.memoryBytes;
+            lock.unlock();
+
+            double duration = 0.0;
+            double seconds = 0.0;
+            std::string error;
+            if (RenderFile(job, config, duration, seconds, error)) {
+                printf("%s -> %s: %.1f s in %.2f s (realtime x%.1f)\n", job.inputPath.c_str(),
+                       job.outputPath.c_str(), duration, seconds, seconds > 0.0 ? duration / seconds : 0.0);
+            } else {
+                fprintf(stderr, "%s\n", error.c_str());
+                ++numFailed;
+            }
+
+            lock.lock();
+            memoryInUse -= job.memoryBytes;
+            budgetFreed.notify_all();
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    const unsigned numThreads = std::min<unsigned>(numJobs, static_cast<unsigned>(runnable.size()));
+    for (unsigned i = 0; i < numThreads; ++i) {
+        threads.emplace_back(worker);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%zu of %zu files in %.2f s on %u threads\n", jobs.size() - numFailed.load(), jobs.size(), elapsed,
+           numThreads);
+    return numFailed.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,476 @@
+// Render-path benchmark for the Linux build boxes. Runs PitchShifterEngine
+// over synthetic guitar material for every combination of block size,
+// sample rate, channel count, processing mode and automation, and reports
+// the per-block cost as a fraction of real time (mean, 99th percentile and
+// worst) plus the allocations the render thread made per block.
+//
+// --save writes the results as a baseline; --baseline compares a run with
+// one and exits non-zero when any case's 99th percentile grew beyond the
+// threshold, or a case that never allocated started to. Compare baselines
+// from the same machine only.
+//
+// Each case runs several times and keeps the best timings, which filters out
+// most of the scheduler noise. Blocks are rendered back to back, not paced
+// to real time, so the hot-swap worker sees less time per block than it
+// would in a host. Allocations are counted at operator new; RubberBand's
+// own malloc() calls are not seen.
+
+#include "PitchShifterEngine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Allocations made on a thread while it renders
+thread_local bool tCountAllocations = false;
+std::atomic<uint64_t> gAllocations(0);
+
+// Unmeasured lead-in, so first-touch page faults and the stretcher filling
+// up don't count
+const double kWarmupSeconds = 0.25;
+
+// Automation: pitch events per block, the pitch and mix sweeps, and how
+// often the formant switch flips (each flip is a hot-swap)
+const uint32_t kPitchEventsPerBlock = 4;
+const double kPitchSweepHz = 0.5;
+const double kMixSweepHz = 0.3;
+const double kFormantFlipSeconds = 0.5;
+
+// Default regression threshold on the 99th percentile, and the growth
+// below which a change counts as jitter however large in relative terms
+const double kDefaultThresholdPercent = 25.0;
+const double kMinRegression = 0.01;
+
+const uint32_t kDefaultRuns = 3;
+
+const uint32_t kDefaultBlockSizes[] = { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+const double kDefaultSampleRates[] = { 44100.0, 48000.0, 96000.0, 192000.0 };
+const uint32_t kDefaultChannelCounts[] = { 1, 2 };
+
+// One processing mode: the construction-time parameters it sets
+struct BenchMode
+{
+    const char* name;
+    float latency;
+    float formant;
+    float stereoMode;
+    float bandSplit;
+    float harmonyVoices;
+    float adaptive;
+    bool stereoOnly;
+};
+
+const BenchMode kModes[] = {
+    { "hq",            kLatencyMode_HighQuality, 0.0f,   kStereoMode_Independent, 0.0f, 0.0f, 0.0f, false },
+    { "hq-formant",    kLatencyMode_HighQuality, 100.0f, kStereoMode_Independent, 0.0f, 0.0f, 0.0f, false },
+    { "short",         kLatencyMode_Short,       0.0f,   kStereoMode_Independent, 0.0f, 0.0f, 0.0f, false },
+    { "short-formant", kLatencyMode_Short,       100.0f, kStereoMode_Independent, 0.0f, 0.0f, 0.0f, false },
+    { "live",          kLatencyMode_Live,        0.0f,   kStereoMode_Independent, 0.0f, 0.0f, 0.0f, false },
+    { "midside",       kLatencyMode_HighQuality, 0.0f,   kStereoMode_MidSide,     0.0f, 0.0f, 0.0f, true },
+    { "mono-fold",     kLatencyMode_HighQuality, 0.0f,   kStereoMode_Mono,        0.0f, 0.0f, 0.0f, true },
+    { "band-split",    kLatencyMode_HighQuality, 0.0f,   kStereoMode_Independent, 1.0f, 0.0f, 0.0f, false },
+    { "harmony",       kLatencyMode_Short,       0.0f,   kStereoMode_Independent, 0.0f, 4.0f, 0.0f, false },
+    { "adaptive",      kLatencyMode_HighQuality, 0.0f,   kStereoMode_Independent, 0.0f, 0.0f, 1.0f, false },
+};
+
+struct BenchCase
+{
+    const BenchMode* mode;
+    uint32_t blockSize;
+    double sampleRate;
+    uint32_t numChannels;
+    bool automated;
+};
+
+struct BenchResult
+{
+    double mean = 0.0;
+    double p99 = 0.0;
+    double worst = 0.0;
+    double allocationsPerBlock = 0.0;
+};
+
+// Baseline key, e.g. "hq/256/48000/2/auto"
+std::string GetCaseKey(const BenchCase& inCase) {
+    char key[128];
+    snprintf(key, sizeof(key), "%s/%u/%.0f/%u/%s", inCase.mode->name, inCase.blockSize, inCase.sampleRate,
+             inCase.numChannels, inCase.automated ? "auto" : "static");
+    return key;
+}
+
+// Plucked notes with a few harmonics: a three-note chord, then a single
+// note, alternating every second so the adaptive engine switches too.
+// The right channel is slightly detuned.
+void MakeInput(double inSampleRate, uint32_t inNumChannels, uint64_t inNumFrames,
+               std::vector<std::vector<float>>& outChannels) {
+    static const double kChord[] = { 82.41, 123.47, 164.81 };
+    static const double kNote = 196.0;
+    const double pluckFrames = 0.5 * inSampleRate;
+
+    outChannels.assign(inNumChannels, std::vector<float>(inNumFrames));
+    for (uint32_t channel = 0; channel < inNumChannels; ++channel) {
+        const double detune = 1.0 + 0.002 * channel;
+        for (uint64_t frame = 0; frame < inNumFrames; ++frame) {
+            const double time = frame / inSampleRate;
+            const double envelope = 0.1 + 0.9 * std::exp(-3.0 * std::fmod(frame, pluckFrames) / pluckFrames);
+            const bool chord = static_cast<uint64_t>(time) % 2 == 0;
+            double sum = 0.0;
+            for (uint32_t note = 0; note < (chord ? 3u : 1u); ++note) {
+                const double frequency = (chord ? kChord[note] : kNote) * detune;
+                for (uint32_t harmonic = 1; harmonic <= 4; ++harmonic) {
+                    sum += std::sin(2.0 * M_PI * frequency * harmonic * time) / harmonic;
+                }
+            }
+            outChannels[channel][frame] = static_cast<float>(0.15 * envelope * sum);
+        }
+    }
+}
+
+// Queues this block's automation: pitch events spread over the block, a
+// mix change, and a formant flip now and then
+void Automate(PitchShifterEngine& ioEngine, uint64_t inPosition, uint32_t inFrames, double inSampleRate) {
+    for (uint32_t event = 0; event < kPitchEventsPerBlock; ++event) {
+        const uint32_t offset = event * inFrames / kPitchEventsPerBlock;
+        const double time = (inPosition + offset) / inSampleRate;
+        ioEngine.SetParameter(kParam_PitchShift, static_cast<float>(12.0 * std::sin(2.0 * M_PI * kPitchSweepHz * time)),
+                              offset);
+    }
+    const double time = inPosition / inSampleRate;
+    ioEngine.SetParameter(kParam_Mix, static_cast<float>(75.0 + 25.0 * std::sin(2.0 * M_PI * kMixSweepHz * time)),
+                          inFrames / 2);
+
+    const uint64_t flipFrames = static_cast<uint64_t>(kFormantFlipSeconds * inSampleRate);
+    if ((inPosition + inFrames) / flipFrames != inPosition / flipFrames) {
+        const bool formant = ((inPosition + inFrames) / flipFrames) % 2 == 1;
+        ioEngine.SetParameter(kParam_Formant, formant ? 100.0f : 0.0f);
+    }
+}
+
+BenchResult RunCase(const BenchCase& inCase, double inSeconds, float inPitchShift) {
+    const BenchMode& mode = *inCase.mode;
+    const double sampleRate = inCase.sampleRate;
+    const uint32_t blockSize = inCase.blockSize;
+    const uint32_t numChannels = inCase.numChannels;
+    const uint64_t warmupFrames = static_cast<uint64_t>(kWarmupSeconds * sampleRate);
+    const uint64_t numFrames = warmupFrames + static_cast<uint64_t>(inSeconds * sampleRate);
+
+    std::vector<std::vector<float>> input;
+    MakeInput(sampleRate, numChannels, numFrames, input);
+
+    PitchShifterEngine engine;
+    float parameters[kNumberOfParameters];
+    std::copy_n(kParameterDefaults, kNumberOfParameters, parameters);
+    parameters[kParam_PitchShift] = inPitchShift;
+    parameters[kParam_Latency] = mode.latency;
+    parameters[kParam_Formant] = mode.formant;
+    parameters[kParam_StereoMode] = mode.stereoMode;
+    parameters[kParam_BandSplit] = mode.bandSplit;
+    parameters[kParam_HarmonyVoices] = mode.harmonyVoices;
+    parameters[kParam_Adaptive] = mode.adaptive;
+    for (uint32_t id = 0; id < kNumberOfParameters; ++id) {
+        engine.SetParameter(id, parameters[id]);
+    }
+    engine.Prepare(sampleRate, numChannels, numChannels, blockSize);
+
+    // The host hands the engine separate, block-sized buffers
+    std::vector<std::vector<float>> inBlock(numChannels, std::vector<float>(blockSize));
+    std::vector<std::vector<float>> outBlock(numChannels, std::vector<float>(blockSize));
+    std::vector<const float*> inPtrs(numChannels);
+    std::vector<float*> outPtrs(numChannels);
+    for (uint32_t channel = 0; channel < numChannels; ++channel) {
+        inPtrs[channel] = inBlock[channel].data();
+        outPtrs[channel] = outBlock[channel].data();
+    }
+
+    std::vector<double> costs;
+    costs.reserve(static_cast<size_t>(numFrames / blockSize + 1));
+    uint64_t allocations = 0;
+
+    for (uint64_t position = 0; position + blockSize <= numFrames; position += blockSize) {
+        for (uint32_t channel = 0; channel < numChannels; ++channel) {
+            std::copy_n(input[channel].begin() + position, blockSize, inBlock[channel].begin());
+        }
+        if (inCase.automated) {
+            Automate(engine, position, blockSize, sampleRate);
+        }
+
+        const uint64_t allocationsBefore = gAllocations.load(std::memory_order_relaxed);
+        tCountAllocations = true;
+        const auto start = std::chrono::steady_clock::now();
+        engine.Process(inPtrs.data(), outPtrs.data(), blockSize);
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        tCountAllocations = false;
+
+        if (position >= warmupFrames) {
+            costs.push_back(elapsed * sampleRate / blockSize);
+            allocations += gAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+        }
+    }
+
+    BenchResult result;
+    if (costs.empty()) {
+        return result;
+    }
+    double total = 0.0;
+    for (double cost : costs) {
+        total += cost;
+    }
+    result.mean = total / costs.size();
+    result.worst = *std::max_element(costs.begin(), costs.end());
+    const size_t p99Index = std::min(costs.size() - 1, static_cast<size_t>(std::ceil(0.99 * costs.size())) - 1);
+    std::nth_element(costs.begin(), costs.begin() + static_cast<ptrdiff_t>(p99Index), costs.end());
+    result.p99 = costs[p99Index];
+    result.allocationsPerBlock = static_cast<double>(allocations) / costs.size();
+    return result;
+}
+
+// Comma-separated numbers
+template <typename T>
+bool ParseList(const char* inText, std::vector<T>& outValues) {
+    outValues.clear();
+    for (const char* text = inText; *text != '\0'; ) {
+        char* end = nullptr;
+        const double value = strtod(text, &end);
+        if (end == text || value <= 0.0) {
+            return false;
+        }
+        outValues.push_back(static_cast<T>(value));
+        text = (*end == ',') ? end + 1 : end;
+        if (*end != ',' && *end != '\0') {
+            return false;
+        }
+    }
+    return !outValues.empty();
+}
+
+bool ParseModes(const char* inText, std::vector<const BenchMode*>& outModes) {
+    outModes.clear();
+    std::string text(inText);
+    for (size_t start = 0; start <= text.size(); ) {
+        const size_t end = std::min(text.find(',', start), text.size());
+        const std::string name = text.substr(start, end - start);
+        const BenchMode* found = nullptr;
+        for (const BenchMode& mode : kModes) {
+            if (name == mode.name) {
+                found = &mode;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        outModes.push_back(found);
+        start = end + 1;
+    }
+    return !outModes.empty();
+}
+
+bool ReadBaseline(const std::string& inPath, std::map<std::string, BenchResult>& outBaseline) {
+    FILE* file = fopen(inPath.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+    char key[128];
+    BenchResult result;
+    while (fscanf(file, "%127s %lf %lf %lf %lf", key, &result.mean, &result.p99, &result.worst,
+                  &result.allocationsPerBlock) == 5) {
+        outBaseline[key] = result;
+    }
+    fclose(file);
+    return true;
+}
+
+void PrintUsage(const char* inProgram) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --blocks LIST    block sizes in frames (default 16,32,64,128,256,512,1024,2048,4096)\n"
+        "  --rates LIST     sample rates (default 44100,48000,96000,192000)\n"
+        "  --channels LIST  1 for mono, 2 for stereo (default 1,2)\n"
+        "  --modes LIST     any of",
+        inProgram);
+    for (const BenchMode& mode : kModes) {
+        fprintf(stderr, " %s", mode.name);
+    }
+    fprintf(stderr, "\n"
+        "                   (default all; midside and mono-fold run in stereo only)\n"
+        "  --automation B   0 static parameters only, 1 automated only (default both)\n"
+        "  --seconds S      audio measured per run, after %.2f s of warm-up (default 1)\n"
+        "  --runs N         runs per case, keeping the best timings (default %u)\n"
+        "  --pitch ST       static pitch shift in semitones (default -5)\n"
+        "  --save FILE      write the results as a baseline\n"
+        "  --baseline FILE  compare with a saved baseline; exit 1 on a regression\n"
+        "  --threshold PCT  99th percentile growth allowed over the baseline (default %.0f)\n",
+        kWarmupSeconds, kDefaultRuns, kDefaultThresholdPercent);
+}
+
+} // namespace
+
+// Count every allocation made while rendering
+void* operator new(std::size_t inSize) {
+    if (tCountAllocations) {
+        gAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* memory = std::malloc(inSize ? inSize : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t inSize) {
+    return operator new(inSize);
+}
+
+void operator delete(void* inMemory) noexcept {
+    std::free(inMemory);
+}
+
+void operator delete[](void* inMemory) noexcept {
+    std::free(inMemory);
+}
+
+void operator delete(void* inMemory, std::size_t) noexcept {
+    std::free(inMemory);
+}
+
+void operator delete[](void* inMemory, std::size_t) noexcept {
+    std::free(inMemory);
+}
+
+int main(int argc, char** argv) {
+    std::vector<uint32_t> blockSizes(std::begin(kDefaultBlockSizes), std::end(kDefaultBlockSizes));
+    std::vector<double> sampleRates(std::begin(kDefaultSampleRates), std::end(kDefaultSampleRates));
+    std::vector<uint32_t> channelCounts(std::begin(kDefaultChannelCounts), std::end(kDefaultChannelCounts));
+    std::vector<const BenchMode*> modes;
+    for (const BenchMode& mode : kModes) {
+        modes.push_back(&mode);
+    }
+    std::vector<bool> automations = { false, true };
+    double seconds = 1.0;
+    uint32_t numRuns = kDefaultRuns;
+    float pitchShift = -5.0f;
+    double thresholdPercent = kDefaultThresholdPercent;
+    std::string savePath;
+    std::string baselinePath;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool valid = true;
+        if (strcmp(arg, "--blocks") == 0 && hasValue) {
+            valid = ParseList(argv[++i], blockSizes);
+        } else if (strcmp(arg, "--rates") == 0 && hasValue) {
+            valid = ParseList(argv[++i], sampleRates);
+        } else if (strcmp(arg, "--channels") == 0 && hasValue) {
+            valid = ParseList(argv[++i], channelCounts) &&
+                    std::all_of(channelCounts.begin(), channelCounts.end(), [](uint32_t n) { return n <= 2; });
+        } else if (strcmp(arg, "--modes") == 0 && hasValue) {
+            valid = ParseModes(argv[++i], modes);
+        } else if (strcmp(arg, "--automation") == 0 && hasValue) {
+            automations = { atoi(argv[++i]) != 0 };
+        } else if (strcmp(arg, "--seconds") == 0 && hasValue) {
+            seconds = atof(argv[++i]);
+            valid = seconds > 0.0;
+        } else if (strcmp(arg, "--runs") == 0 && hasValue) {
+            numRuns = static_cast<uint32_t>(atoi(argv[++i]));
+            valid = numRuns > 0;
+        } else if (strcmp(arg, "--pitch") == 0 && hasValue) {
+            pitchShift = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--save") == 0 && hasValue) {
+            savePath = argv[++i];
+        } else if (strcmp(arg, "--baseline") == 0 && hasValue) {
+            baselinePath = argv[++i];
+        } else if (strcmp(arg, "--threshold") == 0 && hasValue) {
+            thresholdPercent = atof(argv[++i]);
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::map<std::string, BenchResult> baseline;
+    if (!baselinePath.empty() && !ReadBaseline(baselinePath, baseline)) {
+        fprintf(stderr, "cannot read baseline %s\n", baselinePath.c_str());
+        return 1;
+    }
+    FILE* saveFile = nullptr;
+    if (!savePath.empty()) {
+        saveFile = fopen(savePath.c_str(), "w");
+        if (!saveFile) {
+            fprintf(stderr, "cannot write %s\n", savePath.c_str());
+            return 1;
+        }
+    }
+
+    printf("%-34s %8s %8s %8s %10s\n", "case", "mean", "p99", "worst", "allocs/blk");
+    uint32_t numRegressions = 0;
+    for (const BenchMode* mode : modes) {
+        for (uint32_t numChannels : channelCounts) {
+            if (mode->stereoOnly && numChannels < 2) {
+                continue;
+            }
+            for (double sampleRate : sampleRates) {
+                for (uint32_t blockSize : blockSizes) {
+                    for (bool automated : automations) {
+                        const BenchCase benchCase = { mode, blockSize, sampleRate, numChannels, automated };
+                        const std::string key = GetCaseKey(benchCase);
+                        BenchResult result = RunCase(benchCase, seconds, pitchShift);
+                        for (uint32_t run = 1; run < numRuns; ++run) {
+                            const BenchResult next = RunCase(benchCase, seconds, pitchShift);
+                            result.mean = std::min(result.mean, next.mean);
+                            result.p99 = std::min(result.p99, next.p99);
+                            result.worst = std::min(result.worst, next.worst);
+                            result.allocationsPerBlock = std::max(result.allocationsPerBlock, next.allocationsPerBlock);
+                        }
+
+                        printf("%-34s %8.4f %8.4f %8.4f %10.2f%s", key.c_str(), result.mean, result.p99,
+                               result.worst, result.allocationsPerBlock, result.worst > 1.0 ? "  over budget" : "");
+                        if (saveFile) {
+                            fprintf(saveFile, "%s %.6f %.6f %.6f %.4f\n", key.c_str(), result.mean, result.p99,
+                                    result.worst, result.allocationsPerBlock);
+                        }
+
+                        const auto base = baseline.find(key);
+                        if (base != baseline.end()) {
+                            const BenchResult& previous = base->second;
+                            const bool slower = result.p99 > previous.p99 * (1.0 + thresholdPercent / 100.0) &&
+                                                result.p99 - previous.p99 > kMinRegression;
+                            const bool allocating = previous.allocationsPerBlock == 0.0 &&
+                                                    result.allocationsPerBlock > 0.0;
+                            printf("  (p99 was %.4f, %+.0f%%)", previous.p99,
+                                   previous.p99 > 0.0 ? 100.0 * (result.p99 / previous.p99 - 1.0) : 0.0);
+                            if (slower || allocating) {
+                                printf("  REGRESSION%s", allocating ? " (allocates)" : "");
+                                ++numRegressions;
+                            }
+                        } else if (!baseline.empty()) {
+                            printf("  (not in baseline)");
+                        }
+                        printf("\n");
+                        fflush(stdout);
+                    }
+                }
+            }
+        }
+    }
+
+    if (saveFile) {
+        fclose(saveFile);
+    }
+    if (!baseline.empty()) {
+        printf("%u regression%s against %s\n", numRegressions, numRegressions == 1 ? "" : "s",
+               baselinePath.c_str());
+    }
+    return numRegressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,907 @@
+#include "PitchShifterEngine.h"
+#include "StretcherPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Smoothing times for automated parameters
+const double kMixRampSeconds = 0.02;
+const double kPitchRampSeconds = 0.03;
+
+// Crossfade from the old to a rebuilt stretcher
+const double kCrossfadeSeconds = 0.01;
+
+// Input kept for pre-rolling a rebuilt stretcher, and the history ring that
+// holds it (with room for the worker to fall well behind)
+const double kPrerollSeconds = 0.2;
+const double kHistorySeconds = 1.0;
+
+// How often the idle worker checks for work it was not woken for
+const auto kWorkerPollInterval = std::chrono::milliseconds(20);
+
+// Helper threads that share band and voice work with the render thread
+const uint32_t kMaxRenderHelpers = 3;
+
+// Idle gate, on block peaks: input above kGateOpenLevel wakes the engine;
+// it goes idle once input and wet signal have both stayed below
+// kGateCloseLevel for the slot's delay plus kGateHoldSeconds, so the
+// stretcher tail has drained
+const float kGateOpenLevel = 3.16e-4f;   // -70 dBFS
+const float kGateCloseLevel = 1.0e-4f;   // -80 dBFS
+const double kGateHoldSeconds = 0.25;
+
+// Adaptive engine: the detector's aperiodicity is smoothed over
+// kAperiodicitySeconds; PSOLA takes over once it has stayed under
+// kMonophonicThreshold for kMonophonicSeconds, RubberBand once it has stayed
+// over kPolyphonicThreshold for kPolyphonicSeconds. Quiet input changes
+// nothing.
+const double kAperiodicitySeconds = 0.05;
+const float kMonophonicThreshold = 0.15f;
+const float kPolyphonicThreshold = 0.3f;
+const double kMonophonicSeconds = 0.25;
+const double kPolyphonicSeconds = 0.1;
+
+uint32_t RoundUpToPowerOfTwo(uint32_t inValue) {
+    uint32_t value = 1;
+    while (value < inValue) {
+        value <<= 1;
+    }
+    return value;
+}
+
+} // namespace
+
+// Constructor
+PitchShifterEngine::PitchShifterEngine()
+    : mKernels(GetAudioKernels()),
+      mMixRampFrames(0),
+      mPitchRampFrames(0),
+      mFadeFrames(0),
+      mFadePosition(0),
+      mDryDelayFrames(0),
+      mDryFadeDelayFrames(0),
+      mDryFadePosition(0),
+      mAperiodicity(1.0f),
+      mMonophonic(false),
+      mSwitchFrames(0),
+      mSlotsLate(false),
+      mStarvedFrames(0),
+      mIdle(false),
+      mGateQuietFrames(0),
+      mGateHoldFrames(0),
+      mGateWetPeak(0.0f),
+      mGateInputQuiet(false),
+      mHistoryFrames(0),
+      mInputIndex(0),
+      mHistoryStart(0),
+      mRebuildInFlight(false),
+      mRebuildRequested(false),
+      mIncomingSlot(nullptr),
+      mRetiredSlots(nullptr),
+      mWorkerRunning(false),
+      mLatencyListener(nullptr),
+      mLatencyListenerContext(nullptr),
+      mNotifiedLatency(0.0),
+      mSampleRate(0.0),
+      mNumInputChannels(0),
+      mNumOutputChannels(0),
+      mMaxFramesPerBlock(0)
+{
+    std::copy_n(kParameterDefaults, kNumberOfParameters, mRenderValues);
+    std::fill_n(&mLatencyFrames[0][0], kNumberOfLatencyConfigurations * kNumberOfLatencyModes, 0);
+    SnapRamps();
+}
+
+// Destructor
+PitchShifterEngine::~PitchShifterEngine() {
+    Release();
+}
+
+// Allocate the stretcher and render buffers for the stream format
+void PitchShifterEngine::Prepare(double inSampleRate, uint32_t inNumInputChannels, uint32_t inNumOutputChannels,
+                                 uint32_t inMaxFramesPerBlock) {
+    Release();
+
+    mSampleRate = inSampleRate;
+    mNumInputChannels = inNumInputChannels;
+    mNumOutputChannels = inNumOutputChannels;
+    mMaxFramesPerBlock = inMaxFramesPerBlock;
+    mMixRampFrames = static_cast<uint32_t>(kMixRampSeconds * inSampleRate);
+    mPitchRampFrames = static_cast<uint32_t>(kPitchRampSeconds * inSampleRate);
+    mFadeFrames = std::max<uint32_t>(1, static_cast<uint32_t>(kCrossfadeSeconds * inSampleRate));
+    mGateHoldFrames = static_cast<uint32_t>(kGateHoldSeconds * inSampleRate);
+    mSlotsLate = false;
+    mIdle = false;
+    mGateQuietFrames = 0;
+    mStats.Clear();
+    mDetector.Prepare(inSampleRate, inNumInputChannels);
+    mAperiodicity = 1.0f;
+    mMonophonic = false;
+    mSwitchFrames = 0;
+
+    // Start from the latest values without ramping
+    mParameters.ConsumeChanges();
+    for (uint32_t id = 0; id < kNumberOfParameters; ++id) {
+        mRenderValues[id] = mParameters.Get(id);
+    }
+    SnapRamps();
+
+    // Delay of every tier in every configuration, for GetLatencySeconds()
+    // and for lining up the adaptive engines. The pool measures each one
+    // once per process.
+    StretcherPool& pool = StretcherPool::GetInstance();
+    for (int latencyMode = 0; latencyMode < kNumberOfLatencyModes; ++latencyMode) {
+        for (int configuration = 0; configuration < 3; ++configuration) {
+            const StretcherSettings settings = GetSettings(latencyMode, configuration == 1, configuration == 2, false);
+            mLatencyFrames[configuration][latencyMode] =
+                pool.GetDelayFrames(inSampleRate, inNumInputChannels, inMaxFramesPerBlock, settings);
+        }
+        StretcherSettings monophonic = GetStretcherSettings(mRenderValues, inNumInputChannels, inNumOutputChannels,
+                                                            latencyMode, false, false, true);
+        mLatencyFrames[3][latencyMode] = std::max(mLatencyFrames[0][latencyMode],
+            pool.GetDelayFrames(inSampleRate, inNumInputChannels, inMaxFramesPerBlock, monophonic));
+    }
+
+    // The first stretcher comes from the pool or is built right here; later
+    // ones come from the worker
+    mActiveSlot = pool.Acquire(inSampleRate, inNumInputChannels, inMaxFramesPerBlock, GetRequestedSettings());
+    mActiveSlot->SetPitchScale(pow(2.0, mPitchRamp.GetValue() / 12.0));
+    mActiveSlot->SetCrossoverFrequency(mRenderValues[kParam_Crossover]);
+    UpdateVoices();
+
+    mHistoryFrames = RoundUpToPowerOfTwo(static_cast<uint32_t>(kHistorySeconds * inSampleRate) + inMaxFramesPerBlock);
+    mHistory.assign(static_cast<size_t>(inNumInputChannels) * mHistoryFrames, 0.0f);
+    mInputIndex.store(0);
+    mHistoryStart.store(0);
+
+    const uint32_t prerollFrames = static_cast<uint32_t>(kPrerollSeconds * inSampleRate);
+    mWorkerBuffer.assign(static_cast<size_t>(inNumInputChannels) * prerollFrames, 0.0f);
+    mWorkerPtrs.resize(inNumInputChannels);
+    mCatchUpBuffer.assign(static_cast<size_t>(inNumInputChannels) * inMaxFramesPerBlock, 0.0f);
+    mDryBuffer.assign(static_cast<size_t>(2 * inNumInputChannels) * inMaxFramesPerBlock, 0.0f);
+    mDryGainBuffer.assign(inMaxFramesPerBlock, 0.0f);
+    mHistoryPtrs.resize(inNumInputChannels);
+    mDryPtrs.resize(inNumInputChannels);
+    mDryFadePtrs.resize(inNumInputChannels);
+    for (uint32_t channel = 0; channel < inNumInputChannels; ++channel) {
+        mWorkerPtrs[channel] = mWorkerBuffer.data() + static_cast<size_t>(channel) * prerollFrames;
+        mHistoryPtrs[channel] = mCatchUpBuffer.data() + static_cast<size_t>(channel) * inMaxFramesPerBlock;
+        mDryPtrs[channel] = mDryBuffer.data() + static_cast<size_t>(channel) * inMaxFramesPerBlock;
+        mDryFadePtrs[channel] = mDryBuffer.data() + static_cast<size_t>(inNumInputChannels + channel) * inMaxFramesPerBlock;
+    }
+    mDryDelayFrames = GetDryDelayFrames();
+    mDryFadePosition = mFadeFrames;
+
+    // Wet buffers cover the widest slot (every input channel stretched, or
+    // harmony voices panned across every output)
+    const uint32_t numWetChannels = std::max(inNumInputChannels, inNumOutputChannels);
+    mWetBuffer.assign(static_cast<size_t>(numWetChannels) * inMaxFramesPerBlock, 0.0f);
+    mFadeBuffer.assign(static_cast<size_t>(numWetChannels) * inMaxFramesPerBlock, 0.0f);
+    mMixGainBuffer.assign(inMaxFramesPerBlock, 0.0f);
+    mFadeGainBuffer.assign(inMaxFramesPerBlock, 0.0f);
+    mWetPtrs.resize(numWetChannels);
+    mFadePtrs.resize(numWetChannels);
+    for (uint32_t channel = 0; channel < numWetChannels; ++channel) {
+        mWetPtrs[channel] = mWetBuffer.data() + static_cast<size_t>(channel) * inMaxFramesPerBlock;
+        mFadePtrs[channel] = mFadeBuffer.data() + static_cast<size_t>(channel) * inMaxFramesPerBlock;
+    }
+    mSliceInputPtrs.resize(inNumInputChannels);
+    mSliceOutputPtrs.resize(inNumOutputChannels);
+
+    // The render thread takes a share of the work itself
+    const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    mRenderPool.Start(std::clamp<uint32_t>((hardwareThreads > 1) ? hardwareThreads - 1 : 1, 1, kMaxRenderHelpers),
+                      inMaxFramesPerBlock / inSampleRate);
+    StartWorker();
+}
+
+// Stop the worker and free every stretcher
+void PitchShifterEngine::Release() {
+    StopWorker();
+    mRenderPool.Stop();
+
+    // Park the stretchers for the next Prepare(), here or in another instance
+    StretcherPool& pool = StretcherPool::GetInstance();
+    pool.Release(std::move(mActiveSlot));
+    pool.Release(std::move(mFadeSlot));
+    pool.Release(std::unique_ptr<StretcherSlot>(mIncomingSlot.exchange(nullptr)));
+    FreeRetiredSlots();
+    mRebuildRequested.store(false);
+    mRebuildInFlight = false;
+}
+
+// Reset the processor
+void PitchShifterEngine::Reset() {
+    if (!mActiveSlot) {
+        return;
+    }
+
+    // A task that missed its deadline may still be inside a slot
+    mRenderPool.Wait();
+    mSlotsLate = false;
+
+    // Finish any crossfade at once, then restart from silence. An incoming
+    // slot pre-rolled on older input is restarted when it is adopted. The
+    // outgoing slot goes to the worker like a finished fade's.
+    if (mFadeSlot) {
+        RetireSlot(std::move(mActiveSlot));
+        mActiveSlot = std::move(mFadeSlot);
+    }
+    const int64_t index = mInputIndex.load(std::memory_order_relaxed);
+    mHistoryStart.store(index, std::memory_order_release);
+    mActiveSlot->Reset(index);
+    SnapRamps();
+    mActiveSlot->SetPitchScale(pow(2.0, mPitchRamp.GetValue() / 12.0));
+    mDryDelayFrames = GetDryDelayFrames();
+    mDryFadePosition = mFadeFrames;
+}
+
+// Queue a parameter change for the render thread
+void PitchShifterEngine::SetParameter(uint32_t inID, float inValue, uint32_t inBufferOffsetInFrames) {
+    if (inID == kParam_StereoMode) {
+        inValue = std::clamp(std::floor(inValue), kMinStereoMode, kMaxStereoMode);
+    } else if (inID == kParam_Latency) {
+        inValue = std::clamp(std::floor(inValue), kMinLatency, kMaxLatency);
+    } else if (inID == kParam_LegacyLowLatency) {
+        // Kept as set, and selects the tier it meant
+        inValue = std::clamp(inValue, kMinLegacyLowLatency, kMaxLegacyLowLatency);
+        mParameters.Set(inID, inValue, inBufferOffsetInFrames);
+        inID = kParam_Latency;
+        inValue = (inValue > kLegacyLowLatencyThreshold) ? kLatencyMode_Short : kLatencyMode_HighQuality;
+    } else if (inID == kParam_BandSplit) {
+        inValue = (inValue >= 0.5f) ? kMaxBandSplit : kMinBandSplit;
+    } else if (inID == kParam_Crossover) {
+        inValue = std::clamp(inValue, kMinCrossover, kMaxCrossover);
+    } else if (inID == kParam_HarmonyVoices) {
+        inValue = std::clamp(std::floor(inValue), kMinHarmonyVoices, kMaxHarmonyVoices);
+    } else if (inID == kParam_Adaptive) {
+        inValue = (inValue >= 0.5f) ? kMaxAdaptive : kMinAdaptive;
+    } else if (inID == kParam_ZeroLatencyDry) {
+        inValue = (inValue >= 0.5f) ? kMaxZeroLatencyDry : kMinZeroLatencyDry;
+    } else if (IsVoiceParameter(inID)) {
+        switch ((inID - kParam_FirstVoice) % kParamsPerVoice) {
+            case kVoiceParam_Interval:
+                inValue = std::clamp(inValue, kMinVoiceInterval, kMaxVoiceInterval);
+                break;
+            case kVoiceParam_Level:
+                inValue = std::clamp(inValue, kMinVoiceLevel, kMaxVoiceLevel);
+                break;
+            default:
+                inValue = std::clamp(inValue, kMinVoicePan, kMaxVoicePan);
+                break;
+        }
+    }
+    mParameters.Set(inID, inValue, inBufferOffsetInFrames);
+}
+
+float PitchShifterEngine::GetParameter(uint32_t inID) const {
+    return mParameters.Get(inID);
+}
+
+// Wet delay of the configuration most recently set, so a host re-querying
+// right after the change already sees the new tier
+double PitchShifterEngine::GetLatencySeconds() const {
+    if (mSampleRate <= 0.0) {
+        return 0.0;
+    }
+    int configuration = (mParameters.Get(kParam_BandSplit) >= 0.5f) ? 1 : 0;
+    if (mParameters.Get(kParam_HarmonyVoices) >= 1.0f) {
+        configuration = 2;
+    } else if (configuration == 0 && mParameters.Get(kParam_Adaptive) >= 0.5f) {
+        configuration = 3;
+    }
+    const int latencyMode = static_cast<int>(mParameters.Get(kParam_Latency));
+    return mLatencyFrames[configuration][latencyMode] / mSampleRate;
+}
+
+// Construction-time stretcher options for the current parameters
+StretcherSettings PitchShifterEngine::GetRequestedSettings() const {
+    return GetSettings(static_cast<int>(mRenderValues[kParam_Latency]), mRenderValues[kParam_BandSplit] >= 0.5f,
+                       mRenderValues[kParam_HarmonyVoices] >= 1.0f, mRenderValues[kParam_Adaptive] >= 0.5f);
+}
+
+StretcherSettings PitchShifterEngine::GetSettings(int inLatencyMode, bool inBandSplit, bool inHarmony,
+                                                  bool inAdaptive) const {
+    // Adaptive only swaps between PSOLA and plain RubberBand, both read at
+    // the adaptive delay
+    const bool adaptive = inAdaptive && !inBandSplit && !inHarmony && inLatencyMode != kLatencyMode_Live;
+    StretcherSettings settings = GetStretcherSettings(mRenderValues, mNumInputChannels, mNumOutputChannels,
+                                                      inLatencyMode, inBandSplit, inHarmony, adaptive && mMonophonic);
+    if (adaptive) {
+        settings.minDelayFrames = mLatencyFrames[3][inLatencyMode];
+    }
+    return settings;
+}
+
+bool PitchShifterEngine::IsAdaptive() const {
+    return mRenderValues[kParam_Adaptive] >= 0.5f && mRenderValues[kParam_BandSplit] < 0.5f &&
+           mRenderValues[kParam_HarmonyVoices] < 1.0f &&
+           static_cast<int>(mRenderValues[kParam_Latency]) != kLatencyMode_Live;
+}
+
+// Tracks whether the input is one clean voice. The choice feeds
+// GetRequestedSettings(), so a change is built and faded to like any other
+// reconfiguration.
+void PitchShifterEngine::DetectPolyphony(const float* const* inInputs, uint32_t inFrames) {
+    mDetector.Process(inInputs, inFrames);
+    if (mGateInputQuiet) {
+        mSwitchFrames = 0;
+        return;
+    }
+
+    const float smoothing = static_cast<float>(std::exp(-(inFrames / (kAperiodicitySeconds * mSampleRate))));
+    mAperiodicity = mDetector.GetAperiodicity() + smoothing * (mAperiodicity - mDetector.GetAperiodicity());
+
+    const bool other = mMonophonic ? mAperiodicity > kPolyphonicThreshold : mAperiodicity < kMonophonicThreshold;
+    mSwitchFrames = other ? mSwitchFrames + inFrames : 0;
+    const double holdSeconds = mMonophonic ? kPolyphonicSeconds : kMonophonicSeconds;
+    if (mSwitchFrames >= holdSeconds * mSampleRate) {
+        mMonophonic = !mMonophonic;
+        mSwitchFrames = 0;
+    }
+}
+
+// Jump the smoothed parameters to their targets
+void PitchShifterEngine::SnapRamps() {
+    mMixRamp.Reset(mRenderValues[kParam_Mix] / 100.0f);
+    mPitchRamp.Reset(mRenderValues[kParam_PitchShift]);
+}
+
+// Apply one parameter change on the render thread
+void PitchShifterEngine::ApplyParameter(uint32_t inID, float inValue) {
+    mRenderValues[inID] = inValue;
+
+    switch (inID) {
+        case kParam_PitchShift:
+            mPitchRamp.SetTarget(inValue, mPitchRampFrames);
+            break;
+
+        case kParam_Mix:
+            mMixRamp.SetTarget(inValue / 100.0f, mMixRampFrames);
+            break;
+
+        case kParam_Crossover:
+            // Filter coefficients only; no rebuild. Late slots pick it up
+            // when they restart.
+            if (!mSlotsLate) {
+                mActiveSlot->SetCrossoverFrequency(inValue);
+                if (mFadeSlot) {
+                    mFadeSlot->SetCrossoverFrequency(inValue);
+                }
+            }
+            break;
+
+        case kParam_HarmonyVoices:
+            UpdateVoices();
+            break;
+
+        default:
+            if (IsVoiceParameter(inID)) {
+                UpdateVoices();
+                break;
+            }
+
+            // Construction-time options are compared once per block in
+            // Process(), so a sweep across a threshold costs one rebuild
+            break;
+    }
+}
+
+// Voice parameters in the harmonizer's units
+uint32_t PitchShifterEngine::GetVoices(HarmonyVoice* outVoices) const {
+    for (uint32_t voice = 0; voice < kNumberOfHarmonyVoices; ++voice) {
+        outVoices[voice].interval = mRenderValues[VoiceParameter(voice, kVoiceParam_Interval)];
+        outVoices[voice].level = mRenderValues[VoiceParameter(voice, kVoiceParam_Level)] / 100.0f;
+        outVoices[voice].pan = mRenderValues[VoiceParameter(voice, kVoiceParam_Pan)] / 100.0f;
+    }
+    return static_cast<uint32_t>(mRenderValues[kParam_HarmonyVoices]);
+}
+
+// Hand the voices to every slot on the render thread. Turning the
+// harmonizer off keeps its last voices sounding until the crossfade to the
+// rebuilt slot has run.
+void PitchShifterEngine::UpdateVoices() {
+    HarmonyVoice voices[kNumberOfHarmonyVoices];
+    const uint32_t numVoices = GetVoices(voices);
+    if (numVoices == 0 || mSlotsLate) {
+        return;
+    }
+    mActiveSlot->SetVoices(voices, numVoices);
+    if (mFadeSlot) {
+        mFadeSlot->SetVoices(voices, numVoices);
+    }
+}
+
+// Append input to the history ring
+void PitchShifterEngine::WriteHistory(const float* const* inInputs, uint32_t inFrames) {
+    const int64_t index = mInputIndex.load(std::memory_order_relaxed);
+    const uint32_t start = static_cast<uint32_t>(index) & (mHistoryFrames - 1);
+    const uint32_t first = std::min(inFrames, mHistoryFrames - start);
+
+    for (uint32_t channel = 0; channel < mNumInputChannels; ++channel) {
+        float* history = mHistory.data() + static_cast<size_t>(channel) * mHistoryFrames;
+        memcpy(history + start, inInputs[channel], first * sizeof(float));
+        memcpy(history, inInputs[channel] + first, (inFrames - first) * sizeof(float));
+    }
+
+    mInputIndex.store(index + inFrames, std::memory_order_release);
+}
+
+// Copy frames [inFirstIndex, inFirstIndex + inFrames) out of the history ring
+void PitchShifterEngine::ReadHistory(float* const* outData, int64_t inFirstIndex, uint32_t inFrames) const {
+    const uint32_t start = static_cast<uint32_t>(inFirstIndex) & (mHistoryFrames - 1);
+    const uint32_t first = std::min(inFrames, mHistoryFrames - start);
+
+    for (uint32_t channel = 0; channel < mNumInputChannels; ++channel) {
+        const float* history = mHistory.data() + static_cast<size_t>(channel) * mHistoryFrames;
+        memcpy(outData[channel], history + start, first * sizeof(float));
+        memcpy(outData[channel] + first, history, (inFrames - first) * sizeof(float));
+    }
+}
+
+// Delay the dry signal should be heard at: the wet delay of the slot being
+// faded to, or of the active one
+uint32_t PitchShifterEngine::GetDryDelayFrames() const {
+    if (mRenderValues[kParam_ZeroLatencyDry] >= 0.5f) {
+        return 0;
+    }
+    return (mFadeSlot ? mFadeSlot : mActiveSlot)->GetDelayFrames();
+}
+
+// A new dry delay starts fading in on the slice its wet slot does, over the
+// same raised cosine, so the two stay aligned through the swap. A change
+// during a fade waits for it to finish.
+const float* const* PitchShifterEngine::DelayDry(const float* const* inInputs, int64_t inIndex, uint32_t inFrames) {
+    const uint32_t delayFrames = GetDryDelayFrames();
+    if (mDryFadePosition >= mFadeFrames && delayFrames != mDryDelayFrames) {
+        mDryFadeDelayFrames = delayFrames;
+        mDryFadePosition = 0;
+    }
+
+    if (mDryFadePosition >= mFadeFrames) {
+        // With mono fan-out the last input is still read after its aliased
+        // output is written, so it needs a copy even undelayed
+        if (mDryDelayFrames == 0 && mNumOutputChannels <= mNumInputChannels) {
+            return inInputs;
+        }
+        ReadDry(mDryPtrs.data(), inIndex - mDryDelayFrames, inFrames);
+        return mDryPtrs.data();
+    }
+
+    ReadDry(mDryPtrs.data(), inIndex - mDryDelayFrames, inFrames);
+    ReadDry(mDryFadePtrs.data(), inIndex - mDryFadeDelayFrames, inFrames);
+    for (uint32_t frame = 0; frame < inFrames; ++frame) {
+        const float position = std::min(1.0f, static_cast<float>(mDryFadePosition + frame) / mFadeFrames);
+        mDryGainBuffer[frame] = 0.5f - 0.5f * std::cos(static_cast<float>(M_PI) * position);
+    }
+    for (uint32_t channel = 0; channel < mNumInputChannels; ++channel) {
+        mKernels.Crossfade(mDryPtrs[channel], mDryFadePtrs[channel], mDryPtrs[channel], mDryGainBuffer.data(),
+                           inFrames);
+    }
+
+    mDryFadePosition = std::min(mFadeFrames, mDryFadePosition + inFrames);
+    if (mDryFadePosition >= mFadeFrames) {
+        mDryDelayFrames = mDryFadeDelayFrames;
+    }
+    return mDryPtrs.data();
+}
+
+// History frames for the dry signal; frames before the last Reset() are
+// silence, like the wet signal there
+void PitchShifterEngine::ReadDry(float* const* outData, int64_t inFirstIndex, uint32_t inFrames) const {
+    ReadHistory(outData, inFirstIndex, inFrames);
+    const int64_t silentFrames = std::min<int64_t>(mHistoryStart.load(std::memory_order_relaxed) - inFirstIndex,
+                                                   inFrames);
+    if (silentFrames > 0) {
+        for (uint32_t channel = 0; channel < mNumInputChannels; ++channel) {
+            memset(outData[channel], 0, static_cast<size_t>(silentFrames) * sizeof(float));
+        }
+    }
+}
+
+// Feed a slot the history it has not seen, up to inUntilIndex. Returns early
+// (leaving the slot behind) if the ring was overwritten while copying.
+void PitchShifterEngine::CatchUp(StretcherSlot& ioSlot, float* const* inScratch, uint32_t inScratchFrames,
+                                 int64_t inUntilIndex) const {
+    while (ioSlot.GetNextInputIndex() < inUntilIndex) {
+        const int64_t first = ioSlot.GetNextInputIndex();
+        const uint32_t frames = static_cast<uint32_t>(std::min<int64_t>(inUntilIndex - first, inScratchFrames));
+        ReadHistory(inScratch, first, frames);
+
+        // The render thread may have lapped us while we copied
+        if (mInputIndex.load(std::memory_order_acquire) - first > mHistoryFrames) {
+            return;
+        }
+        ioSlot.Write(inScratch, frames);
+    }
+}
+
+// Ask the worker for a stretcher built with new settings
+void PitchShifterEngine::RequestRebuild(const StretcherSettings& inSettings) {
+    mRequest.settings = inSettings;
+    mRequest.pitchScale = pow(2.0, mPitchRamp.GetTarget() / 12.0);
+    mRequest.crossoverFrequency = mRenderValues[kParam_Crossover];
+    mRequest.numVoices = GetVoices(mRequest.voices);
+    mRebuildInFlight = true;
+    mRebuildRequested.store(true, std::memory_order_release);
+    mStats.RecordRebuildRequest();
+
+    // Never blocks; a missed wake-up is covered by the worker's poll
+    mWorkerWake.notify_one();
+}
+
+// Take over a slot the worker finished and start the crossfade to it
+void PitchShifterEngine::AdoptIncomingSlot() {
+    StretcherSlot* incoming = mIncomingSlot.exchange(nullptr, std::memory_order_acquire);
+    if (!incoming) {
+        return;
+    }
+    mFadeSlot.reset(incoming);
+    mRebuildInFlight = false;
+
+    // The worker leaves at most a block or two to catch up on. If a Reset()
+    // or a very slow build left it on stale input, restart it instead.
+    const int64_t index = mInputIndex.load(std::memory_order_relaxed);
+    if (mFadeSlot->GetNextInputIndex() < mHistoryStart.load(std::memory_order_relaxed) ||
+        index - mFadeSlot->GetNextInputIndex() > mHistoryFrames) {
+        mFadeSlot->Reset(index);
+        mStats.RecordSlotSwap(true);
+    } else {
+        CatchUp(*mFadeSlot, mHistoryPtrs.data(), mMaxFramesPerBlock, index);
+        mStats.RecordSlotSwap(false);
+    }
+    mFadeSlot->SetPitchScale(pow(2.0, mPitchRamp.GetValue() / 12.0));
+    mFadeSlot->SetCrossoverFrequency(mRenderValues[kParam_Crossover]);
+    UpdateVoices();
+    mFadePosition = 0;
+}
+
+// Hand a slot to the worker to free. Never blocks or frees; any number may
+// wait, since each links to the next.
+void PitchShifterEngine::RetireSlot(std::unique_ptr<StretcherSlot> inSlot) {
+    StretcherSlot* slot = inSlot.release();
+    StretcherSlot* head = mRetiredSlots.load(std::memory_order_relaxed);
+    do {
+        slot->SetNextRetired(head);
+    } while (!mRetiredSlots.compare_exchange_weak(head, slot, std::memory_order_release, std::memory_order_relaxed));
+    mWorkerWake.notify_one();
+}
+
+void PitchShifterEngine::SetLatencyListener(LatencyListener inListener, void* inContext) {
+    mLatencyListener = inListener;
+    mLatencyListenerContext = inContext;
+}
+
+void PitchShifterEngine::StartWorker() {
+    mNotifiedLatency = GetLatencySeconds();
+    mWorkerRunning.store(true);
+    mWorker = std::thread(&PitchShifterEngine::WorkerLoop, this);
+}
+
+void PitchShifterEngine::StopWorker() {
+    if (!mWorker.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mWorkerMutex);
+        mWorkerRunning.store(false);
+    }
+    mWorkerWake.notify_one();
+    mWorker.join();
+}
+
+// Builds (or takes from the pool) and pre-rolls replacement stretchers,
+// parks retired ones, and reports latency changes
+void PitchShifterEngine::WorkerLoop() {
+    const uint32_t prerollFrames = static_cast<uint32_t>(mWorkerBuffer.size() / std::max<uint32_t>(1, mNumInputChannels));
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mWorkerMutex);
+            mWorkerWake.wait_for(lock, kWorkerPollInterval, [this] {
+                return !mWorkerRunning.load() || mRebuildRequested.load() || mRetiredSlots.load() != nullptr;
+            });
+        }
+        if (!mWorkerRunning.load()) {
+            return;
+        }
+
+        const double latency = GetLatencySeconds();
+        if (latency != mNotifiedLatency) {
+            mNotifiedLatency = latency;
+            if (mLatencyListener) {
+                mLatencyListener(mLatencyListenerContext);
+            }
+        }
+
+        FreeRetiredSlots();
+
+        if (!mRebuildRequested.exchange(false, std::memory_order_acquire)) {
+            continue;
+        }
+
+        auto slot = StretcherPool::GetInstance().Acquire(mSampleRate, mNumInputChannels, mMaxFramesPerBlock,
+                                                         mRequest.settings);
+        slot->SetPitchScale(mRequest.pitchScale);
+        slot->SetCrossoverFrequency(mRequest.crossoverFrequency);
+        slot->SetVoices(mRequest.voices, mRequest.numVoices);
+
+        // Pre-roll on the most recent input, then keep catching up until the
+        // render thread only has a block or so left to feed
+        const int64_t end = mInputIndex.load(std::memory_order_acquire);
+        slot->Reset(std::max(mHistoryStart.load(std::memory_order_acquire), end - prerollFrames));
+        for (int pass = 0; pass < 4; ++pass) {
+            const int64_t until = mInputIndex.load(std::memory_order_acquire);
+            if (until - slot->GetNextInputIndex() <= mMaxFramesPerBlock) {
+                break;
+            }
+            CatchUp(*slot, mWorkerPtrs.data(), prerollFrames, until);
+        }
+
+        mIncomingSlot.store(slot.release(), std::memory_order_release);
+    }
+}
+
+// Park every retired slot in the pool
+void PitchShifterEngine::FreeRetiredSlots() {
+    StretcherSlot* slot = mRetiredSlots.exchange(nullptr, std::memory_order_acquire);
+    while (slot) {
+        StretcherSlot* next = slot->GetNextRetired();
+        StretcherPool::GetInstance().Release(std::unique_ptr<StretcherSlot>(slot));
+        slot = next;
+    }
+}
+
+// Process audio
+void PitchShifterEngine::Process(const float* const* inInputs, float* const* outOutputs, uint32_t inFramesToProcess) {
+    const auto blockStart = std::chrono::steady_clock::now();
+    mStarvedFrames = 0;
+
+    // Pick up immediate parameter changes once per block
+    uint64_t changes = mParameters.ConsumeChanges();
+    for (uint32_t id = 0; changes != 0; ++id, changes >>= 1) {
+        if (changes & 1) {
+            ApplyParameter(id, mParameters.Get(id));
+        }
+    }
+
+    // Idle: stay bypassed until the input opens the gate, then restart the
+    // stretcher on this very block so the onset goes through it
+    float inputPeak = 0.0f;
+    for (uint32_t channel = 0; channel < mNumInputChannels; ++channel) {
+        inputPeak = std::max(inputPeak, mKernels.Peak(inInputs[channel], inFramesToProcess));
+    }
+    if (mIdle) {
+        if (inputPeak < kGateOpenLevel) {
+            ProcessIdle(inInputs, outOutputs, inFramesToProcess);
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - blockStart).count();
+            mStats.RecordIdleBlock(inFramesToProcess, seconds, inFramesToProcess / mSampleRate);
+            return;
+        }
+        Wake();
+    }
+    mGateWetPeak = 0.0f;
+    mGateInputQuiet = inputPeak < kGateCloseLevel;
+
+    if (IsAdaptive()) {
+        DetectPolyphony(inInputs, inFramesToProcess);
+    }
+
+    // Split the block at offset automation events
+    const uint32_t numEvents = mParameters.PopEvents(mPendingEvents, ParameterStore::kMaxPendingEvents);
+    uint32_t start = 0;
+    for (uint32_t i = 0; i <= numEvents; ++i) {
+        const uint32_t end = (i < numEvents) ? std::min(mPendingEvents[i].offsetInFrames, inFramesToProcess)
+                                             : inFramesToProcess;
+        if (end > start) {
+            for (uint32_t channel = 0; channel < mNumInputChannels; ++channel) {
+                mSliceInputPtrs[channel] = inInputs[channel] + start;
+            }
+            for (uint32_t channel = 0; channel < mNumOutputChannels; ++channel) {
+                mSliceOutputPtrs[channel] = outOutputs[channel] + start;
+            }
+            ProcessSlice(mSliceInputPtrs.data(), mSliceOutputPtrs.data(), end - start);
+            start = end;
+        }
+        if (i < numEvents) {
+            ApplyParameter(mPendingEvents[i].id, mPendingEvents[i].value);
+        }
+    }
+
+    // Construction-time options changed: have the worker build a stretcher
+    // (one at a time; a change made meanwhile is picked up afterwards)
+    if (!mRebuildInFlight && !mFadeSlot) {
+        const StretcherSettings settings = GetRequestedSettings();
+        if (settings != mActiveSlot->GetSettings()) {
+            RequestRebuild(settings);
+        }
+    }
+
+    // Go idle once input and wet signal have been quiet for long enough.
+    // Never during a hot-swap, so no half-built slot is left behind.
+    if (mGateInputQuiet && mGateWetPeak < kGateCloseLevel) {
+        mGateQuietFrames += inFramesToProcess;
+    } else {
+        mGateQuietFrames = 0;
+    }
+    if (mGateQuietFrames >= static_cast<uint64_t>(mActiveSlot->GetDelayFrames()) + mGateHoldFrames &&
+        !mFadeSlot && !mRebuildInFlight && !mSlotsLate) {
+        mIdle = true;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - blockStart).count();
+    mStats.RecordBlock(inFramesToProcess, seconds, inFramesToProcess / mSampleRate, mStarvedFrames,
+                       mSlotsLate ? 0 : mActiveSlot->GetBufferedFrames());
+}
+
+// Bypassed block: the stretcher is skipped and the wet signal is silence.
+// The input still goes into the history and parameters still apply.
+void PitchShifterEngine::ProcessIdle(const float* const* inInputs, float* const* outOutputs, uint32_t inFrames) {
+    const uint32_t numEvents = mParameters.PopEvents(mPendingEvents, ParameterStore::kMaxPendingEvents);
+    for (uint32_t i = 0; i < numEvents; ++i) {
+        ApplyParameter(mPendingEvents[i].id, mPendingEvents[i].value);
+    }
+    SnapRamps();
+
+    // Before the outputs are written: they may alias the inputs
+    const int64_t index = mInputIndex.load(std::memory_order_relaxed);
+    WriteHistory(inInputs, inFrames);
+    const float* const* dryInputs = DelayDry(inInputs, index, inFrames);
+
+    const float dry = 1.0f - mMixRamp.GetValue();
+    for (uint32_t channel = 0; channel < mNumOutputChannels; ++channel) {
+        mKernels.GainRamp(dryInputs[std::min(channel, mNumInputChannels - 1)], outOutputs[channel], dry, 0.0f,
+                          inFrames);
+    }
+}
+
+// Leave idle: the input before this block was below the gate, so a
+// stretcher restarted from silence here sounds the same as one that kept
+// running, and its delay-aligned output picks up without a step
+void PitchShifterEngine::Wake() {
+    mIdle = false;
+    mGateQuietFrames = 0;
+    mActiveSlot->Reset(mInputIndex.load(std::memory_order_relaxed));
+    mActiveSlot->SetPitchScale(pow(2.0, mPitchRamp.GetValue() / 12.0));
+    mStats.RecordWake();
+}
+
+// The pool is idle again after a missed deadline: restart the slots it left
+// half-written from silence, and hand them what changed meanwhile
+void PitchShifterEngine::RestartLateSlots(int64_t inIndex) {
+    const double pitchScale = pow(2.0, mPitchRamp.GetValue() / 12.0);
+    mActiveSlot->Reset(inIndex);
+    mActiveSlot->SetPitchScale(pitchScale);
+    mActiveSlot->SetCrossoverFrequency(mRenderValues[kParam_Crossover]);
+    if (mFadeSlot) {
+        mFadeSlot->Reset(inIndex);
+        mFadeSlot->SetPitchScale(pitchScale);
+        mFadeSlot->SetCrossoverFrequency(mRenderValues[kParam_Crossover]);
+    }
+    mSlotsLate = false;
+    UpdateVoices();
+}
+
+// Render one slice with constant parameter targets
+void PitchShifterEngine::ProcessSlice(const float* const* inInputs, float* const* outOutputs, uint32_t inFramesToProcess) {
+    const int64_t index = mInputIndex.load(std::memory_order_relaxed);
+
+    if (mSlotsLate && !mRenderPool.IsBusy()) {
+        RestartLateSlots(index);
+    }
+    if (!mFadeSlot && !mSlotsLate) {
+        AdoptIncomingSlot();
+    }
+    WriteHistory(inInputs, inFramesToProcess);
+
+    // Pitch glides per slice; RubberBand picks the scale up on its next hop
+    if (mPitchRamp.IsRamping()) {
+        const double pitchScale = pow(2.0, mPitchRamp.Advance(inFramesToProcess) / 12.0);
+        if (!mSlotsLate) {
+            mActiveSlot->SetPitchScale(pitchScale);
+            if (mFadeSlot) {
+                mFadeSlot->SetPitchScale(pitchScale);
+            }
+        }
+    }
+
+    // Each slot returns the wet signal for this slice's frames, its own
+    // delay earlier on the input timeline
+    const bool wasLate = mSlotsLate;
+    uint32_t starved = 0;
+    uint32_t numWetChannels = mActiveSlot->GetNumWetChannels();
+    if (IsAdaptive() && !mSlotsLate) {
+        // DetectPolyphony() already ran YIN on this block
+        mActiveSlot->SetPitchEstimate(mDetector.GetPeriodFrames(), mDetector.GetAperiodicity());
+        if (mFadeSlot) {
+            mFadeSlot->SetPitchEstimate(mDetector.GetPeriodFrames(), mDetector.GetAperiodicity());
+        }
+    }
+    if (!mSlotsLate) {
+        if (mActiveSlot->Write(inInputs, inFramesToProcess, &mRenderPool)) {
+            starved = mActiveSlot->Read(mWetPtrs.data(), index - mActiveSlot->GetDelayFrames(), inFramesToProcess);
+        } else {
+            mSlotsLate = true;
+        }
+    }
+
+    if (mFadeSlot && !mSlotsLate && !mFadeSlot->Write(inInputs, inFramesToProcess, &mRenderPool)) {
+        mSlotsLate = true;
+    }
+    if (mFadeSlot && !mSlotsLate) {
+        starved = std::max(starved, mFadeSlot->Read(mFadePtrs.data(), index - mFadeSlot->GetDelayFrames(),
+                                                    inFramesToProcess));
+
+        // Raised-cosine crossfade; both sides are the same material, so the
+        // gains sum to one
+        const uint32_t numFadeChannels = mFadeSlot->GetNumWetChannels();
+        const uint32_t numChannels = std::max(numWetChannels, numFadeChannels);
+        for (uint32_t frame = 0; frame < inFramesToProcess; ++frame) {
+            const float position = std::min(1.0f, static_cast<float>(mFadePosition + frame) / mFadeFrames);
+            mFadeGainBuffer[frame] = 0.5f - 0.5f * std::cos(static_cast<float>(M_PI) * position);
+        }
+        for (uint32_t channel = numChannels; channel-- > 0; ) {
+            const float* oldData = mWetPtrs[std::min(channel, numWetChannels - 1)];
+            const float* newData = mFadePtrs[std::min(channel, numFadeChannels - 1)];
+            mKernels.Crossfade(oldData, newData, mWetPtrs[channel], mFadeGainBuffer.data(), inFramesToProcess);
+        }
+        numWetChannels = numChannels;
+
+        mFadePosition += inFramesToProcess;
+        if (mFadePosition >= mFadeFrames) {
+            // Fade done: the worker frees the old stretcher
+            RetireSlot(std::move(mActiveSlot));
+            mActiveSlot = std::move(mFadeSlot);
+        }
+    }
+
+    // Late slots give silence, counted as starved
+    if (mSlotsLate) {
+        for (uint32_t channel = 0; channel < numWetChannels; ++channel) {
+            std::fill_n(mWetPtrs[channel], inFramesToProcess, 0.0f);
+        }
+        starved = inFramesToProcess;
+        if (!wasLate) {
+            mStats.RecordMissedDeadline();
+        }
+    }
+    mStarvedFrames += starved;
+
+    // Wet level for the idle gate, only needed while the input is quiet
+    if (mGateInputQuiet) {
+        for (uint32_t channel = 0; channel < numWetChannels; ++channel) {
+            mGateWetPeak = std::max(mGateWetPeak, mKernels.Peak(mWetPtrs[channel], inFramesToProcess));
+        }
+    }
+
+    const float* const* dryInputs = DelayDry(inInputs, index, inFramesToProcess);
+
+    // Wet gain for this slice, shared by every channel
+    const bool mixRamping = mMixRamp.IsRamping();
+    const float wet = mMixRamp.GetValue();
+    if (mixRamping) {
+        for (uint32_t frame = 0; frame < inFramesToProcess; ++frame) {
+            mMixGainBuffer[frame] = mMixRamp.Next();
+        }
+    }
+
+    // Apply wet/dry mix; the kernels work element-wise, so in-place buffers
+    // are safe. Outputs beyond the wet channels reuse the last one (mono
+    // fan-out).
+    for (uint32_t channel = 0; channel < mNumOutputChannels; ++channel) {
+        const float* wetData = mWetPtrs[std::min(channel, numWetChannels - 1)];
+        const float* inputData = dryInputs[std::min(channel, mNumInputChannels - 1)];
+        float* outputData = outOutputs[channel];
+
+        if (mixRamping) {
+            mKernels.Crossfade(inputData, wetData, outputData, mMixGainBuffer.data(), inFramesToProcess);
+        } else if (wet >= 1.0f) {
+            memcpy(outputData, wetData, inFramesToProcess * sizeof(float));
+        } else {
+            mKernels.Mix(inputData, wetData, outputData, wet, inFramesToProcess);
+        }
+    }
+}
@@ -0,0 +1,305 @@
+// Standard library headers
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AudioKernels.h"
+#include "PitchShifterParameters.h"
+#include "PitchDetector.h"
+#include "RenderStats.h"
+#include "StretcherSlot.h"
+
+// Include guards
+#ifndef __PitchShifterEngine_h__
+#define __PitchShifterEngine_h__
+
+// Host-agnostic DSP core. Owns the RubberBand stretcher and the parameter
+// state and renders blocks of non-interleaved floats, so the same render path
+// runs inside the AudioUnit and in the Linux command line tools.
+//
+// Input and output pass through FIFOs, so the host block size is independent
+// of the stretcher's hop size and every Process() call emits exactly the
+// requested number of frames without touching the heap.
+//
+// All stretched channels go through one RubberBand instance in a single
+// process() call. Mono inputs, and any input in kStereoMode_Mono, are
+// stretched as one channel and copied to every output, so mono-to-stereo and
+// dual-mono layouts pay for a single analysis.
+//
+// Parameters may be set from any thread. The render thread picks them up
+// once per block, splits the block at offset automation events and ramps
+// mix and pitch, so fast sweeps neither zipper nor reconfigure mid-hop.
+//
+// kParam_Latency selects the processing tier: RubberBand with its standard
+// or short window, or the time-domain GranularShifter for live monitoring.
+// It has its own ID; the 0-100% kParam_LegacyLowLatency it replaced still
+// picks the short window above 50%, so older sessions keep RubberBand.
+// kParam_BandSplit stretches lows and highs separately (see StretcherSlot);
+// the render thread and a helper from mRenderPool take one band each.
+//
+// kParam_HarmonyVoices replaces the shifter with a Harmonizer: up to eight
+// voices, each with its own interval, level and pan, resynthesized from one
+// shared analysis, the voices spread over mRenderPool. The latency tier
+// picks its window; kParam_PitchShift transposes every voice and kParam_Mix
+// blends the voices with the dry signal.
+//
+// kParam_Adaptive lets the RubberBand tiers hand single-note material to a
+// PsolaShifter at a fraction of the cost. A PitchDetector watches the input
+// every block; after a quarter second of clean periodicity the engine swaps
+// to PSOLA, and back to RubberBand within a tenth of a second of chords or
+// noise. Both are read at the larger of their delays, so the reported
+// latency stays put and each swap is an ordinary sample-aligned crossfade.
+//
+// Parameters that are fixed at construction (formant mode, latency tier,
+// stereo mode, band split, harmonizer on/off, the adaptive engine's choice)
+// never rebuild on the render thread. A worker thread builds the replacement
+// stretcher, pre-rolls it with recent input, and the render thread
+// crossfades to it over a few milliseconds.
+//
+// The dry share of kParam_Mix is read back from the history ring at the
+// active slot's delay, so a partial mix lines up with the wet signal instead
+// of comb-filtering against it. When a hot-swap changes the delay, the dry
+// signal crossfades to the new one alongside the wet. kParam_ZeroLatencyDry
+// mixes the undelayed input instead, for players who would rather hear
+// their dry signal straight away.
+//
+// Silent instances go idle: once input and wet signal have stayed below
+// -80 dBFS past the stretcher's delay and tail, the stretcher is bypassed
+// (the dry share of the mix still passes) until input crosses -70 dBFS. The
+// block that wakes the engine restarts the stretcher and is rendered
+// through it, so the onset is kept and the wet signal resumes from silence.
+//
+// Every block is timed and recorded in RenderStats along with stretcher
+// stalls, the wet frames buffered and hot-swaps, cheaply enough to stay on
+// in production; GetRenderStats() reads them from any thread.
+//
+// Stretchers come from the process-wide StretcherPool and go back to it on
+// Release() and when retired by a hot-swap, so re-initializing a session
+// or switching a setting back reuses them instead of building new ones.
+// FFT and window tables are shared between instances through SharedCache.
+class PitchShifterEngine
+{
+public:
+    PitchShifterEngine();
+    ~PitchShifterEngine();
+
+    // Allocates the stretcher and all render buffers for the given stream
+    // format. Must be called before Process() and again whenever the format
+    // or the maximum block size changes.
+    void Prepare(double inSampleRate, uint32_t inNumInputChannels, uint32_t inNumOutputChannels,
+                 uint32_t inMaxFramesPerBlock);
+    void Release();
+
+    // Clears all audio state without allocating or freeing, so hosts may
+    // call it on every transport stop/start. Not concurrent with Process().
+    void Reset();
+    bool IsPrepared() const { return mActiveSlot != nullptr; }
+
+    // Any thread; see ParameterStore
+    void SetParameter(uint32_t inID, float inValue, uint32_t inBufferOffsetInFrames = 0);
+    float GetParameter(uint32_t inID) const;
+
+    // Renders inFramesToProcess (<= the prepared maximum) frames from every
+    // prepared input to every prepared output. Output n may alias input n.
+    void Process(const float* const* inInputs, float* const* outOutputs, uint32_t inFramesToProcess);
+
+    double GetSampleRate() const { return mSampleRate; }
+    uint32_t GetNumInputChannels() const { return mNumInputChannels; }
+    uint32_t GetNumOutputChannels() const { return mNumOutputChannels; }
+    uint32_t GetNumStretchChannels() const { return mActiveSlot ? mActiveSlot->GetNumStretchChannels() : 0; }
+    uint32_t GetNumWetChannels() const { return mActiveSlot ? mActiveSlot->GetNumWetChannels() : 0; }
+    uint32_t GetMaxFramesPerBlock() const { return mMaxFramesPerBlock; }
+
+    // Wet signal delay for the selected latency mode. Any thread, once
+    // prepared.
+    double GetLatencySeconds() const;
+
+    // Called on the worker thread, within a poll interval, whenever
+    // GetLatencySeconds() changes while prepared. Parameter changes may
+    // arrive on the render thread, so this is where a host wrapper can tell
+    // its listeners without locking or allocating there. Set before
+    // Prepare().
+    using LatencyListener = void (*)(void* inContext);
+    void SetLatencyListener(LatencyListener inListener, void* inContext);
+
+    // Render cost, stalls and reconfigurations since Prepare(). Any thread;
+    // a clear takes effect at the next block.
+    void GetRenderStats(RenderStatsSnapshot& outSnapshot) const { mStats.Snapshot(outSnapshot); }
+    void ClearRenderStats() { mStats.RequestClear(); }
+
+private:
+    // Stretcher construction settings for the current render values, and
+    // for the same values in another latency mode, band split, harmony and
+    // adaptive setting
+    StretcherSettings GetRequestedSettings() const;
+    StretcherSettings GetSettings(int inLatencyMode, bool inBandSplit, bool inHarmony, bool inAdaptive) const;
+
+    // Adaptive engine: whether it applies to the render values, and the
+    // per-block mono/poly decision
+    bool IsAdaptive() const;
+    void DetectPolyphony(const float* const* inInputs, uint32_t inFrames);
+
+    // Harmony voices from the render values; returns how many sound
+    uint32_t GetVoices(HarmonyVoice* outVoices) const;
+    void UpdateVoices();
+
+    // Render-thread parameter handling
+    void ApplyParameter(uint32_t inID, float inValue);
+    void SnapRamps();
+
+    // Renders one slice between automation events
+    void ProcessSlice(const float* const* inInputs, float* const* outOutputs, uint32_t inFrames);
+
+    // Dry signal for the slice starting at inIndex, already in the history
+    // ring: inInputs itself when undelayed and no input feeds two outputs,
+    // else a (delayed) copy
+    uint32_t GetDryDelayFrames() const;
+    const float* const* DelayDry(const float* const* inInputs, int64_t inIndex, uint32_t inFrames);
+    void ReadDry(float* const* outData, int64_t inFirstIndex, uint32_t inFrames) const;
+
+    // Idle bypass: renders a block without the stretcher, and restarts it
+    void ProcessIdle(const float* const* inInputs, float* const* outOutputs, uint32_t inFrames);
+    void Wake();
+    void RestartLateSlots(int64_t inIndex);
+
+    // Input history, used to pre-roll and catch up replacement stretchers
+    void WriteHistory(const float* const* inInputs, uint32_t inFrames);
+    void ReadHistory(float* const* outData, int64_t inFirstIndex, uint32_t inFrames) const;
+    void CatchUp(StretcherSlot& ioSlot, float* const* inScratch, uint32_t inScratchFrames, int64_t inUntilIndex) const;
+
+    // Hot-swap: render side
+    void RequestRebuild(const StretcherSettings& inSettings);
+    void AdoptIncomingSlot();
+    void RetireSlot(std::unique_ptr<StretcherSlot> inSlot);
+
+    // Hot-swap: worker side
+    void StartWorker();
+    void StopWorker();
+    void WorkerLoop();
+    void FreeRetiredSlots();
+
+    // Vector loops for the mix and crossfade
+    const AudioKernels& mKernels;
+
+    // Parameters: the shared store, and the render thread's view of it
+    ParameterStore mParameters;
+    float mRenderValues[kNumberOfParameters];
+    ParameterEvent mPendingEvents[ParameterStore::kMaxPendingEvents];
+    LinearRamp mMixRamp;        // 0-1 wet gain
+    LinearRamp mPitchRamp;      // semitones
+    uint32_t mMixRampFrames;
+    uint32_t mPitchRampFrames;
+
+    // The stretcher being heard, and the one being faded in
+    std::unique_ptr<StretcherSlot> mActiveSlot;
+    std::unique_ptr<StretcherSlot> mFadeSlot;
+    uint32_t mFadeFrames;
+    uint32_t mFadePosition;
+
+    // Delay the dry signal is read at, and the one being faded to
+    // (mDryFadePosition stays at mFadeFrames between fades)
+    uint32_t mDryDelayFrames;
+    uint32_t mDryFadeDelayFrames;
+    uint32_t mDryFadePosition;
+
+    // Delay of each latency tier at the prepared format, for plain (0),
+    // band split (1), harmony (2) and adaptive (3) slots. Adaptive is the
+    // larger of the RubberBand and PSOLA delays, which both are read at.
+    static const int kNumberOfLatencyConfigurations = 4;
+    uint32_t mLatencyFrames[kNumberOfLatencyConfigurations][kNumberOfLatencyModes];
+
+    // Adaptive engine (render thread): the detector on the input, its
+    // smoothed aperiodicity, the current choice, and how long the input has
+    // argued for the other one
+    PitchDetector mDetector;
+    float mAperiodicity;
+    bool mMonophonic;
+    uint32_t mSwitchFrames;
+
+    // Shares band split and harmony voice work with the render thread. A
+    // task that misses the pool's deadline leaves the slots late: they are
+    // not touched, and the wet signal is silence, until the pool is idle.
+    RenderWorkerPool mRenderPool;
+    bool mSlotsLate;
+
+    // Render thread instrumentation; mStarvedFrames collects the current
+    // block's stalls across its slices
+    RenderStats mStats;
+    uint32_t mStarvedFrames;
+
+    // Idle gate (render thread): quiet time so far, and this block's levels
+    bool mIdle;
+    uint64_t mGateQuietFrames;
+    uint32_t mGateHoldFrames;
+    float mGateWetPeak;
+    bool mGateInputQuiet;
+
+    // Recent input on the engine timeline (all input channels). Written by
+    // the render thread only; the worker copies from it and re-checks
+    // mInputIndex afterwards to detect frames overwritten meanwhile.
+    std::vector<float> mHistory;
+    uint32_t mHistoryFrames;                // Power of two
+    std::atomic<int64_t> mInputIndex;       // Timeline index of the next input frame
+    std::atomic<int64_t> mHistoryStart;     // Oldest valid index (moves on Reset)
+
+    // Hand-off with the worker thread. The render thread fills the request
+    // and raises mRebuildRequested; the worker builds and pre-rolls the slot,
+    // publishes it in mIncomingSlot and frees the slots retired since its
+    // last pass, a lock-free list linked through the slots themselves.
+    struct RebuildRequest
+    {
+        StretcherSettings settings;
+        double pitchScale = 1.0;
+        double crossoverFrequency = kDefaultCrossover;
+        HarmonyVoice voices[kNumberOfHarmonyVoices];
+        uint32_t numVoices = 0;
+    };
+    RebuildRequest mRequest;
+    std::vector<float> mWorkerBuffer;
+    std::vector<float*> mWorkerPtrs;
+    bool mRebuildInFlight;
+    std::atomic<bool> mRebuildRequested;
+    std::atomic<StretcherSlot*> mIncomingSlot;
+    std::atomic<StretcherSlot*> mRetiredSlots;
+    std::atomic<bool> mWorkerRunning;
+    std::thread mWorker;
+    std::mutex mWorkerMutex;
+    std::condition_variable mWorkerWake;
+
+    // Latency change notification (worker thread): the listener and the
+    // latency it last heard about
+    LatencyListener mLatencyListener;
+    void* mLatencyListenerContext;
+    double mNotifiedLatency;
+
+    // Preallocated render scratch: one host block of wet signal per
+    // wet channel for each slot, one of history for catching up an
+    // incoming slot, two of delayed dry signal per input channel, plus the
+    // per-frame gains
+    std::vector<float> mWetBuffer;
+    std::vector<float> mFadeBuffer;
+    std::vector<float> mCatchUpBuffer;
+    std::vector<float> mDryBuffer;
+    std::vector<float> mMixGainBuffer;
+    std::vector<float> mFadeGainBuffer;
+    std::vector<float> mDryGainBuffer;
+    std::vector<float*> mWetPtrs;
+    std::vector<float*> mFadePtrs;
+    std::vector<float*> mHistoryPtrs;
+    std::vector<float*> mDryPtrs;
+    std::vector<float*> mDryFadePtrs;
+    std::vector<const float*> mSliceInputPtrs;
+    std::vector<float*> mSliceOutputPtrs;
+
+    // States
+    double mSampleRate;
+    uint32_t mNumInputChannels;
+    uint32_t mNumOutputChannels;
+    uint32_t mMaxFramesPerBlock;
+};
+
+#endif /* __PitchShifterEngine_h__ */
@@ -0,0 +1,162 @@
+#include "PitchShifterParameters.h"
+#include <algorithm>
+
+const float kParameterDefaults[kNumberOfParameters] = {
+    kDefaultPitchShift,
+    kDefaultMix,
+    kDefaultFormant,
+    kDefaultLegacyLowLatency,
+    kDefaultStereoMode,
+    kDefaultBandSplit,
+    kDefaultCrossover,
+    kDefaultHarmonyVoices,
+    kDefaultVoiceIntervals[0], kDefaultVoiceLevel, kDefaultVoicePans[0],
+    kDefaultVoiceIntervals[1], kDefaultVoiceLevel, kDefaultVoicePans[1],
+    kDefaultVoiceIntervals[2], kDefaultVoiceLevel, kDefaultVoicePans[2],
+    kDefaultVoiceIntervals[3], kDefaultVoiceLevel, kDefaultVoicePans[3],
+    kDefaultVoiceIntervals[4], kDefaultVoiceLevel, kDefaultVoicePans[4],
+    kDefaultVoiceIntervals[5], kDefaultVoiceLevel, kDefaultVoicePans[5],
+    kDefaultVoiceIntervals[6], kDefaultVoiceLevel, kDefaultVoicePans[6],
+    kDefaultVoiceIntervals[7], kDefaultVoiceLevel, kDefaultVoicePans[7],
+    kDefaultAdaptive, kDefaultZeroLatencyDry,
+    kDefaultLatency
+};
+
+static_assert(kNumberOfParameters <= 64, "dirty mask holds one bit per parameter");
+static_assert((ParameterStore::kMaxPendingEvents & (ParameterStore::kMaxPendingEvents - 1)) == 0,
+              "event queue size must be a power of two");
+
+// Constructor
+ParameterStore::ParameterStore()
+    : mDirtyMask(0),
+      mStamp(0),
+      mEnqueuePosition(0),
+      mDequeuePosition(0)
+{
+    for (uint32_t id = 0; id < kNumberOfParameters; ++id) {
+        mValues[id].store(kParameterDefaults[id], std::memory_order_relaxed);
+        mImmediateStamps[id].store(0, std::memory_order_relaxed);
+    }
+    for (uint32_t i = 0; i < kMaxPendingEvents; ++i) {
+        mEvents[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+void ParameterStore::Set(uint32_t inID, float inValue, uint32_t inBufferOffsetInFrames) {
+    if (inID >= kNumberOfParameters) {
+        return;
+    }
+    const uint32_t stamp = mStamp.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    if (inBufferOffsetInFrames > 0) {
+        // Claim a slot; a slot is free when its sequence equals the position
+        uint32_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+        for (;;) {
+            EventSlot& slot = mEvents[position & (kMaxPendingEvents - 1)];
+            const int32_t diff = static_cast<int32_t>(slot.sequence.load(std::memory_order_acquire) - position);
+            if (diff == 0) {
+                if (mEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.event = { inID, inValue, inBufferOffsetInFrames };
+                    slot.stamp = stamp;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+
+                    // Readers see the new value; the render thread applies it
+                    // from the event, not from the dirty mask
+                    mValues[inID].store(inValue, std::memory_order_relaxed);
+                    return;
+                }
+            } else if (diff < 0) {
+                break;  // Queue full, fall back to an immediate change
+            } else {
+                position = mEnqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    mValues[inID].store(inValue, std::memory_order_relaxed);
+    mImmediateStamps[inID].store(stamp, std::memory_order_relaxed);
+    mDirtyMask.fetch_or(uint64_t(1) << inID, std::memory_order_release);
+}
+
+float ParameterStore::Get(uint32_t inID) const {
+    return inID < kNumberOfParameters ? mValues[inID].load(std::memory_order_relaxed) : 0.0f;
+}
+
+uint64_t ParameterStore::ConsumeChanges() {
+    return mDirtyMask.exchange(0, std::memory_order_acquire);
+}
+
+uint32_t ParameterStore::PopEvents(ParameterEvent* outEvents, uint32_t inMaxEvents) {
+    uint32_t count = 0;
+    while (count < inMaxEvents) {
+        EventSlot& slot = mEvents[mDequeuePosition & (kMaxPendingEvents - 1)];
+        const int32_t diff = static_cast<int32_t>(slot.sequence.load(std::memory_order_acquire) - (mDequeuePosition + 1));
+        if (diff < 0) {
+            break;
+        }
+
+        // Left out when an immediate change to the same ID came after it
+        const uint32_t immediateStamp = mImmediateStamps[slot.event.id].load(std::memory_order_relaxed);
+        if (static_cast<int32_t>(slot.stamp - immediateStamp) > 0) {
+            outEvents[count++] = slot.event;
+        }
+        slot.sequence.store(mDequeuePosition + kMaxPendingEvents, std::memory_order_release);
+        ++mDequeuePosition;
+    }
+
+    // Stable insertion sort; events for the same frame keep arrival order
+    for (uint32_t i = 1; i < count; ++i) {
+        const ParameterEvent event = outEvents[i];
+        uint32_t j = i;
+        while (j > 0 && outEvents[j - 1].offsetInFrames > event.offsetInFrames) {
+            outEvents[j] = outEvents[j - 1];
+            --j;
+        }
+        outEvents[j] = event;
+    }
+
+    return count;
+}
+
+// Constructor
+LinearRamp::LinearRamp()
+    : mValue(0.0f),
+      mTarget(0.0f),
+      mStep(0.0f),
+      mRemaining(0)
+{
+}
+
+void LinearRamp::Reset(float inValue) {
+    mValue = inValue;
+    mTarget = inValue;
+    mStep = 0.0f;
+    mRemaining = 0;
+}
+
+void LinearRamp::SetTarget(float inTarget, uint32_t inRampFrames) {
+    mTarget = inTarget;
+    if (inRampFrames == 0 || inTarget == mValue) {
+        Reset(inTarget);
+        return;
+    }
+    mStep = (inTarget - mValue) / inRampFrames;
+    mRemaining = inRampFrames;
+}
+
+float LinearRamp::Next() {
+    if (mRemaining > 0) {
+        mValue = (--mRemaining == 0) ? mTarget : mValue + mStep;
+    }
+    return mValue;
+}
+
+float LinearRamp::Advance(uint32_t inFrames) {
+    if (inFrames >= mRemaining) {
+        Reset(mTarget);
+    } else {
+        mValue += mStep * inFrames;
+        mRemaining -= inFrames;
+    }
+    return mValue;
+}
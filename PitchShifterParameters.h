@@ -0,0 +1,208 @@
+// Standard library headers
+#include <atomic>
+#include <cstdint>
+
+// Include guards
+#ifndef __PitchShifterParameters_h__
+#define __PitchShifterParameters_h__
+
+// Harmony voices, each with kParamsPerVoice parameters after
+// kParam_FirstVoice (see VoiceParameter())
+const uint32_t kNumberOfHarmonyVoices = 8;
+const uint32_t kParamsPerVoice = 3;
+
+// Custom parameters for our plugin
+enum {
+    kParam_PitchShift = 0,  // -12 to +12 semitones
+    kParam_Mix,            // Dry/wet mix (0-100%)
+    kParam_Formant,        // Formant preservation (0-100%)
+    kParam_LegacyLowLatency, // Pre-tier "Low Latency Mode" (0-100%), kept for saved sessions
+    kParam_StereoMode,     // Channel handling, one of the stereo modes below
+    kParam_BandSplit,      // Two-band processing for low strings (0=off, 1=on)
+    kParam_Crossover,      // Band split frequency (60-500 Hz)
+    kParam_HarmonyVoices,  // Harmonizer voices (0=off, 1-8)
+    kParam_FirstVoice,     // Voice parameters, kParamsPerVoice per voice
+    kParam_Adaptive = kParam_FirstVoice + kNumberOfHarmonyVoices * kParamsPerVoice,  // Monophonic fast path (0=off, 1=on)
+    kParam_ZeroLatencyDry, // Dry signal not delayed to the wet one (0=off, 1=on)
+    kParam_Latency,        // Processing tier, one of the latency modes below
+    kNumberOfParameters
+};
+
+// Per-voice parameters, in order
+enum {
+    kVoiceParam_Interval = 0,  // -24 to +24 semitones on top of the pitch shift
+    kVoiceParam_Level,         // 0-100%
+    kVoiceParam_Pan            // -100 (left) to +100 (right)
+};
+
+// Parameter ID of one voice's parameter
+inline uint32_t VoiceParameter(uint32_t inVoice, uint32_t inVoiceParam) {
+    return kParam_FirstVoice + inVoice * kParamsPerVoice + inVoiceParam;
+}
+
+inline bool IsVoiceParameter(uint32_t inID) {
+    return inID >= kParam_FirstVoice && inID < kParam_Adaptive;
+}
+
+// Stereo modes
+enum {
+    kStereoMode_Independent = 0,  // Every channel analysed on its own
+    kStereoMode_MidSide,          // Stereo pair analysed together (RubberBand OptionChannelsTogether)
+    kStereoMode_Mono,             // Inputs folded to mono, stretched once, fanned out to every output
+    kNumberOfStereoModes
+};
+
+// Latency modes, from best quality to lowest delay
+enum {
+    kLatencyMode_HighQuality = 0,  // RubberBand with its standard analysis window
+    kLatencyMode_Short,            // RubberBand with OptionWindowShort
+    kLatencyMode_Live,             // Time-domain granular shifter, under 5 ms
+    kNumberOfLatencyModes
+};
+
+// Parameter ranges
+const float kMinPitchShift = -12.0f;
+const float kMaxPitchShift = 12.0f;
+const float kDefaultPitchShift = 0.0f;
+
+const float kMinMix = 0.0f;
+const float kMaxMix = 100.0f;
+const float kDefaultMix = 100.0f;
+
+const float kMinFormant = 0.0f;
+const float kMaxFormant = 100.0f;
+const float kDefaultFormant = 0.0f;
+
+// Sessions from before the tiers stored 0-100 under kParam_LegacyLowLatency;
+// above kLegacyLowLatencyThreshold meant low latency
+const float kMinLegacyLowLatency = 0.0f;
+const float kMaxLegacyLowLatency = 100.0f;
+const float kDefaultLegacyLowLatency = 0.0f;
+const float kLegacyLowLatencyThreshold = 50.0f;
+
+const float kMinLatency = 0.0f;
+const float kMaxLatency = kNumberOfLatencyModes - 1;
+const float kDefaultLatency = kLatencyMode_HighQuality;
+
+const float kMinStereoMode = 0.0f;
+const float kMaxStereoMode = kNumberOfStereoModes - 1;
+const float kDefaultStereoMode = kStereoMode_Independent;
+
+const float kMinBandSplit = 0.0f;
+const float kMaxBandSplit = 1.0f;
+const float kDefaultBandSplit = 0.0f;
+
+const float kMinCrossover = 60.0f;
+const float kMaxCrossover = 500.0f;
+const float kDefaultCrossover = 200.0f;
+
+const float kMinHarmonyVoices = 0.0f;
+const float kMaxHarmonyVoices = kNumberOfHarmonyVoices;
+const float kDefaultHarmonyVoices = 0.0f;
+
+const float kMinVoiceInterval = -24.0f;
+const float kMaxVoiceInterval = 24.0f;
+const float kMinVoiceLevel = 0.0f;
+const float kMaxVoiceLevel = 100.0f;
+const float kDefaultVoiceLevel = 100.0f;
+const float kMinVoicePan = -100.0f;
+const float kMaxVoicePan = 100.0f;
+
+const float kMinAdaptive = 0.0f;
+const float kMaxAdaptive = 1.0f;
+const float kDefaultAdaptive = 0.0f;
+
+const float kMinZeroLatencyDry = 0.0f;
+const float kMaxZeroLatencyDry = 1.0f;
+const float kDefaultZeroLatencyDry = 0.0f;
+
+// Per-voice defaults: a triad and octaves first, spread across the stereo
+// field
+constexpr float kDefaultVoiceIntervals[kNumberOfHarmonyVoices] = { 4.0f, 7.0f, 12.0f, -12.0f, 3.0f, -5.0f, 9.0f, 5.0f };
+constexpr float kDefaultVoicePans[kNumberOfHarmonyVoices] = { -50.0f, 50.0f, -25.0f, 25.0f, -75.0f, 75.0f, -10.0f, 10.0f };
+
+// Default value of every parameter, indexed by parameter ID
+extern const float kParameterDefaults[kNumberOfParameters];
+
+// A parameter change that lands partway into the next rendered block
+struct ParameterEvent
+{
+    uint32_t id;
+    float value;
+    uint32_t offsetInFrames;
+};
+
+// Hand-off between the threads that set parameters (UI, automation, host)
+// and the render thread. Immediate changes are one atomic store plus a bit in
+// a dirty mask; changes with a buffer offset go through a bounded lock-free
+// queue. Every change is stamped from one counter, so an immediate change
+// supersedes the offset events for its ID that were queued before it. The
+// render thread never waits on a writer.
+class ParameterStore
+{
+public:
+    ParameterStore();
+
+    // Any thread. Events that do not fit in the queue are applied at the
+    // start of the next block instead. An immediate change drops the queued
+    // events for the same ID, which would otherwise land after it.
+    void Set(uint32_t inID, float inValue, uint32_t inBufferOffsetInFrames = 0);
+
+    // Latest immediate value, any thread
+    float Get(uint32_t inID) const;
+
+    // Render thread only: IDs changed since the last call, as a bit mask
+    uint64_t ConsumeChanges();
+
+    // Render thread only: drains pending offset events, sorted by offset,
+    // leaving out those superseded by an immediate change
+    uint32_t PopEvents(ParameterEvent* outEvents, uint32_t inMaxEvents);
+
+    static const uint32_t kMaxPendingEvents = 64;
+
+private:
+    struct EventSlot
+    {
+        std::atomic<uint32_t> sequence;
+        ParameterEvent event;
+        uint32_t stamp;
+    };
+
+    std::atomic<float> mValues[kNumberOfParameters];
+    std::atomic<uint64_t> mDirtyMask;
+
+    // Order of all changes, and the stamp of each ID's last immediate one
+    std::atomic<uint32_t> mStamp;
+    std::atomic<uint32_t> mImmediateStamps[kNumberOfParameters];
+
+    // Multi-producer, single-consumer ring (sequence-numbered slots)
+    EventSlot mEvents[kMaxPendingEvents];
+    std::atomic<uint32_t> mEnqueuePosition;
+    uint32_t mDequeuePosition;
+};
+
+// Linear ramp towards a target, advanced per sample or per chunk on the
+// render thread
+class LinearRamp
+{
+public:
+    LinearRamp();
+
+    void Reset(float inValue);
+    void SetTarget(float inTarget, uint32_t inRampFrames);
+
+    float GetValue() const { return mValue; }
+    float GetTarget() const { return mTarget; }
+    bool IsRamping() const { return mRemaining > 0; }
+
+    float Next();
+    float Advance(uint32_t inFrames);
+
+private:
+    float mValue;
+    float mTarget;
+    float mStep;
+    uint32_t mRemaining;
+};
+
+#endif /* __PitchShifterParameters_h__ */
@@ -0,0 +1,229 @@
+// Offline render harness for the Linux build boxes. Streams a WAV or AIFF
+// file through PitchShifterEngine at a fixed block size, exactly like a host
+// would, and reports the per-block render cost against the real-time budget.
+// Intended to be run under `perf record` / `perf stat`.
+
+#include "AudioFile.h"
+#include "PitchShifterEngine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+// One histogram as "bin:count" pairs, skipping empty bins
+void PrintHistogram(const char* inLabel, const uint64_t* inBins) {
+    printf("  %-8s", inLabel);
+    for (uint32_t bin = 0; bin < RenderStatsSnapshot::kNumberOfBins; ++bin) {
+        if (inBins[bin] != 0) {
+            printf(" %u:%llu", bin, static_cast<unsigned long long>(inBins[bin]));
+        }
+    }
+    printf("\n");
+}
+
+void PrintRenderStats(const PitchShifterEngine& inEngine, double inAudioSeconds) {
+    RenderStatsSnapshot stats;
+    inEngine.GetRenderStats(stats);
+    const double meanSeconds = stats.blocks ? stats.totalSeconds / stats.blocks : 0.0;
+    printf("[%.1f s] blocks %llu  mean %.1f us  worst %.1f us  budget last %.3f worst %.3f  over %llu\n",
+           inAudioSeconds, static_cast<unsigned long long>(stats.blocks), meanSeconds * 1e6,
+           stats.worstSeconds * 1e6, stats.lastBudgetRatio, stats.worstBudgetRatio,
+           static_cast<unsigned long long>(stats.overBudgetBlocks));
+    printf("  starved %llu blocks (%llu frames)  buffered last %u min %u  rebuilds %llu  swaps %llu (%llu restarted)\n",
+           static_cast<unsigned long long>(stats.starvedBlocks), static_cast<unsigned long long>(stats.starvedFrames),
+           stats.lastBufferedFrames, stats.minBufferedFrames,
+           static_cast<unsigned long long>(stats.rebuildRequests), static_cast<unsigned long long>(stats.slotSwaps),
+           static_cast<unsigned long long>(stats.slotRestarts));
+    printf("  idle %llu blocks  wakeups %llu  missed deadlines %llu\n", static_cast<unsigned long long>(stats.idleBlocks),
+           static_cast<unsigned long long>(stats.wakeups), static_cast<unsigned long long>(stats.missedDeadlines));
+    PrintHistogram("log2 us", stats.blockTimeHistogram);
+    PrintHistogram("budget/8", stats.budgetRatioHistogram);
+    PrintHistogram("log2 buf", stats.bufferedHistogram);
+}
+
+void PrintUsage(const char* inProgram) {
+    fprintf(stderr,
+        "usage: %s [options] input.wav|aif output.wav\n"
+        "  --block N        host block size in frames (default 256)\n"
+        "  --rate HZ        sample rate to run the engine at (default: file rate)\n"
+        "  --pitch ST       pitch shift in semitones (default %.0f)\n"
+        "  --mix PCT        dry/wet mix in percent (default %.0f)\n"
+        "  --formant PCT    formant preservation in percent (default %.0f)\n"
+        "  --latency M      0 high quality, 1 low latency, 2 live (default %.0f)\n"
+        "  --stereo-mode M  0 independent, 1 mid/side, 2 mono (default %.0f)\n"
+        "  --band-split B   1 to stretch lows and highs separately (default %.0f)\n"
+        "  --crossover HZ   band split frequency (default %.0f)\n"
+        "  --voices N       harmony voices, 0 for plain pitch shifting (default %.0f)\n"
+        "  --voice V:ST:LEVEL:PAN\n"
+        "                   voice V (1-%u): interval in semitones, level and pan in percent\n"
+        "  --adaptive B     1 to hand single-note input to the PSOLA shifter (default %.0f)\n"
+        "  --zero-latency-dry B\n"
+        "                   1 to mix the dry signal undelayed instead of aligned to the wet (default %.0f)\n"
+        "  --out-channels N output channel count (default: input count)\n"
+        "  --stats-every S  dump the engine's render statistics every S seconds of audio\n",
+        inProgram, kDefaultPitchShift, kDefaultMix, kDefaultFormant, kDefaultLatency, kDefaultStereoMode,
+        kDefaultBandSplit, kDefaultCrossover, kDefaultHarmonyVoices, kNumberOfHarmonyVoices,
+        kDefaultAdaptive, kDefaultZeroLatencyDry);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t blockSize = 256;
+    double sampleRate = 0.0;
+    uint32_t numOutputChannels = 0;
+    double statsInterval = 0.0;
+    float parameters[kNumberOfParameters];
+    std::copy_n(kParameterDefaults, kNumberOfParameters, parameters);
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--block") == 0 && hasValue) {
+            blockSize = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(arg, "--rate") == 0 && hasValue) {
+            sampleRate = atof(argv[++i]);
+        } else if (strcmp(arg, "--pitch") == 0 && hasValue) {
+            parameters[kParam_PitchShift] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--mix") == 0 && hasValue) {
+            parameters[kParam_Mix] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--formant") == 0 && hasValue) {
+            parameters[kParam_Formant] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--latency") == 0 && hasValue) {
+            parameters[kParam_Latency] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--stereo-mode") == 0 && hasValue) {
+            parameters[kParam_StereoMode] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--band-split") == 0 && hasValue) {
+            parameters[kParam_BandSplit] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--crossover") == 0 && hasValue) {
+            parameters[kParam_Crossover] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--voices") == 0 && hasValue) {
+            parameters[kParam_HarmonyVoices] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--voice") == 0 && hasValue) {
+            unsigned voice = 0;
+            float interval = 0.0f;
+            float level = 0.0f;
+            float pan = 0.0f;
+            if (sscanf(argv[++i], "%u:%f:%f:%f", &voice, &interval, &level, &pan) != 4 ||
+                voice < 1 || voice > kNumberOfHarmonyVoices) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            parameters[VoiceParameter(voice - 1, kVoiceParam_Interval)] = interval;
+            parameters[VoiceParameter(voice - 1, kVoiceParam_Level)] = level;
+            parameters[VoiceParameter(voice - 1, kVoiceParam_Pan)] = pan;
+        } else if (strcmp(arg, "--adaptive") == 0 && hasValue) {
+            parameters[kParam_Adaptive] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--zero-latency-dry") == 0 && hasValue) {
+            parameters[kParam_ZeroLatencyDry] = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--out-channels") == 0 && hasValue) {
+            numOutputChannels = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(arg, "--stats-every") == 0 && hasValue) {
+            statsInterval = atof(argv[++i]);
+        } else if (arg[0] == '-') {
+            PrintUsage(argv[0]);
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.size() != 2 || blockSize == 0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    MappedAudioFile input;
+    std::string error;
+    if (!input.Open(paths[0], error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const uint32_t numInputChannels = input.GetNumChannels();
+    const uint64_t numFrames = input.GetNumFrames();
+    if (sampleRate <= 0.0) {
+        sampleRate = input.GetSampleRate();
+    }
+    if (numOutputChannels == 0) {
+        numOutputChannels = numInputChannels;
+    }
+
+    PitchShifterEngine engine;
+    for (uint32_t id = 0; id < kNumberOfParameters; ++id) {
+        engine.SetParameter(id, parameters[id]);
+    }
+    engine.Prepare(sampleRate, numInputChannels, numOutputChannels, blockSize);
+
+    WavFileWriter output;
+    if (!output.Open(paths[1], sampleRate, numOutputChannels, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    // The host hands the engine separate, block-sized buffers
+    std::vector<std::vector<float>> inBlock(numInputChannels, std::vector<float>(blockSize));
+    std::vector<std::vector<float>> outBlock(numOutputChannels, std::vector<float>(blockSize));
+    std::vector<float*> inPtrs(numInputChannels);
+    std::vector<float*> outPtrs(numOutputChannels);
+    for (uint32_t channel = 0; channel < numInputChannels; ++channel) {
+        inPtrs[channel] = inBlock[channel].data();
+    }
+    for (uint32_t channel = 0; channel < numOutputChannels; ++channel) {
+        outPtrs[channel] = outBlock[channel].data();
+    }
+
+    const double budgetSeconds = blockSize / sampleRate;
+    double totalSeconds = 0.0;
+    double worstSeconds = 0.0;
+    uint64_t numBlocks = 0;
+    const uint64_t statsFrames = static_cast<uint64_t>(statsInterval * sampleRate);
+    uint64_t nextStatsFrame = statsFrames;
+
+    for (uint64_t position = 0; position < numFrames; position += blockSize) {
+        const uint32_t frames = static_cast<uint32_t>(std::min<uint64_t>(blockSize, numFrames - position));
+        input.Read(inPtrs.data(), position, frames);
+
+        const auto start = std::chrono::steady_clock::now();
+        engine.Process(inPtrs.data(), outPtrs.data(), frames);
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        totalSeconds += elapsed;
+        worstSeconds = std::max(worstSeconds, elapsed);
+        ++numBlocks;
+
+        if (!output.Write(outPtrs.data(), frames, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+
+        if (statsFrames > 0 && position + frames >= nextStatsFrame) {
+            PrintRenderStats(engine, (position + frames) / sampleRate);
+            nextStatsFrame += statsFrames;
+        }
+    }
+
+    if (!output.Close(error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    const double meanSeconds = numBlocks ? totalSeconds / numBlocks : 0.0;
+    printf("%s: %llu frames, %u -> %u ch (%u stretched), %.0f Hz, block %u\n",
+           paths[0].c_str(), static_cast<unsigned long long>(numFrames),
+           numInputChannels, numOutputChannels, engine.GetNumStretchChannels(), sampleRate, blockSize);
+    printf("blocks %llu  mean %.1f us (%.3f of budget)  worst %.1f us (%.3f of budget)  realtime x%.1f\n",
+           static_cast<unsigned long long>(numBlocks),
+           meanSeconds * 1e6, meanSeconds / budgetSeconds,
+           worstSeconds * 1e6, worstSeconds / budgetSeconds,
+           totalSeconds > 0.0 ? (numFrames / sampleRate) / totalSeconds : 0.0);
+    PrintRenderStats(engine, numFrames / sampleRate);
+
+    return 0;
+}
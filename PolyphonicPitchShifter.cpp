@@ -13,18 +13,40 @@ OSStatus PolyphonicPitchShifter::CreateEffectInstance(AudioComponentInstance inI
 
 // Constructor
 PolyphonicPitchShifter::PolyphonicPitchShifter(AudioComponentInstance inComponentInstance)
-    : ausdk::AUEffectBase(inComponentInstance),
-      mPitchShift(kDefaultPitchShift),
-      mMix(kDefaultMix),
-      mFormant(kDefaultFormant),
-      mLatency(kDefaultLatency),
-      mNeedReconfiguration(true)
+    : ausdk::AUEffectBase(inComponentInstance)
 {
     // Set default parameter values
     SetParameter(kParam_PitchShift, kAudioUnitScope_Global, 0, kDefaultPitchShift, 0);
     SetParameter(kParam_Mix, kAudioUnitScope_Global, 0, kDefaultMix, 0);
     SetParameter(kParam_Formant, kAudioUnitScope_Global, 0, kDefaultFormant, 0);
     SetParameter(kParam_Latency, kAudioUnitScope_Global, 0, kDefaultLatency, 0);
+    SetParameter(kParam_LegacyLowLatency, kAudioUnitScope_Global, 0, kDefaultLegacyLowLatency, 0);
+    SetParameter(kParam_StereoMode, kAudioUnitScope_Global, 0, kDefaultStereoMode, 0);
+    SetParameter(kParam_BandSplit, kAudioUnitScope_Global, 0, kDefaultBandSplit, 0);
+    SetParameter(kParam_Crossover, kAudioUnitScope_Global, 0, kDefaultCrossover, 0);
+    SetParameter(kParam_HarmonyVoices, kAudioUnitScope_Global, 0, kDefaultHarmonyVoices, 0);
+    for (UInt32 id = kParam_FirstVoice; IsVoiceParameter(id); ++id) {
+        SetParameter(id, kAudioUnitScope_Global, 0, kParameterDefaults[id], 0);
+    }
+    SetParameter(kParam_Adaptive, kAudioUnitScope_Global, 0, kDefaultAdaptive, 0);
+    SetParameter(kParam_ZeroLatencyDry, kAudioUnitScope_Global, 0, kDefaultZeroLatencyDry, 0);
+
+    mEngine.SetLatencyListener(&PolyphonicPitchShifter::LatencyChanged, this);
+}
+
+// Latency listener, on the engine's worker thread
+void PolyphonicPitchShifter::LatencyChanged(void* inContext) {
+    static_cast<PolyphonicPitchShifter*>(inContext)->PropertyChanged(kAudioUnitProperty_Latency,
+                                                                     kAudioUnitScope_Global, 0);
+}
+
+// Supported channel layouts: mono, mono-to-stereo and stereo
+UInt32 PolyphonicPitchShifter::SupportedNumChannels(const AUChannelInfo** outInfo) {
+    static const AUChannelInfo sChannelInfo[] = { { 1, 1 }, { 1, 2 }, { 2, 2 } };
+    if (outInfo) {
+        *outInfo = sChannelInfo;
+    }
+    return sizeof(sChannelInfo) / sizeof(sChannelInfo[0]);
 }
 
 // Initialize the audio unit
@@ -36,19 +58,13 @@ OSStatus PolyphonicPitchShifter::Initialize() {
 
     // Get audio format info
     const AudioStreamBasicDescription& inputFormat = GetInput(0)->GetStreamFormat();
+    const AudioStreamBasicDescription& outputFormat = GetOutput(0)->GetStreamFormat();
     UInt32 maxFrames = GetMaxFramesPerSlice();
 
-    // Create the RubberBand stretcher
-    mStretcher = std::make_unique<RubberBand::RubberBandStretcher>(
-        inputFormat.mSampleRate,
-        inputFormat.mChannelsPerFrame,
-        RubberBand::RubberBandStretcher::OptionProcessRealTime |
-        RubberBand::RubberBandStretcher::OptionPitchHighQuality
-    );
-
-    // Configure initial state
-    ReconfigureStretcher();
-    mStretcher->setMaxProcessSize(maxFrames);
+    // Create the engine and the channel pointer tables it renders through
+    mEngine.Prepare(inputFormat.mSampleRate, inputFormat.mChannelsPerFrame, outputFormat.mChannelsPerFrame, maxFrames);
+    mInputBuffers.assign(inputFormat.mChannelsPerFrame, nullptr);
+    mOutputBuffers.assign(outputFormat.mChannelsPerFrame, nullptr);
 
     return noErr;
 }
@@ -60,7 +76,7 @@ PolyphonicPitchShifter::~PolyphonicPitchShifter() {
 
 // Cleanup resources
 void PolyphonicPitchShifter::Cleanup() {
-    mStretcher.reset();
+    mEngine.Release();
 }
 
 // Reset the processor
@@ -70,44 +86,11 @@ OSStatus PolyphonicPitchShifter::Reset(AudioUnitScope inScope, AudioUnitElement
         return result;
     }
 
-    if (mStretcher) {
-        mStretcher->reset();
-    }
+    mEngine.Reset();
 
     return noErr;
 }
 
-// Update stretcher configuration based on parameters
-void PolyphonicPitchShifter::ReconfigureStretcher() {
-    if (!mStretcher) {
-        return;
-    }
-
-    // Set pitch shift
-    mStretcher->setPitchScale(pow(2.0, mPitchShift / 12.0));
-
-    // Set transients mode - using OptionTransientsCrisp instead of OptionTransientsPreserve
-    mStretcher->setTransientsOption(RubberBand::RubberBandStretcher::OptionTransientsCrisp);
-
-    // Set formant preservation
-    RubberBand::RubberBandStretcher::Options options = mStretcher->getOptions();
-    if (mFormant > 50.0f) {
-        options |= RubberBand::RubberBandStretcher::OptionFormantPreserved;
-    } else {
-        options &= ~RubberBand::RubberBandStretcher::OptionFormantPreserved;
-    }
-    mStretcher->setOptions(options);
-
-    // Set latency mode
-    if (mLatency > 50.0f) {
-        mStretcher->setTimeRatio(1.0);
-    } else {
-        mStretcher->setTimeRatio(1.0);  // Same setting, but could be adjusted for different latency modes
-    }
-
-    mNeedReconfiguration = false;
-}
-
 // Process audio
 OSStatus PolyphonicPitchShifter::ProcessBufferLists(
     AudioUnitRenderActionFlags& ioActionFlags,
@@ -115,66 +98,26 @@ OSStatus PolyphonicPitchShifter::ProcessBufferLists(
     AudioBufferList& outBuffer,
     UInt32 inFramesToProcess
 ) {
-    // Check if we need to reconfigure the stretcher
-    if (mNeedReconfiguration) {
-        ReconfigureStretcher();
+    if (!mEngine.IsPrepared()) {
+        return kAudioUnitErr_Uninitialized;
     }
 
-    // Check for formant preservation changes
-    int currentOptions = mStretcher->getOptions();
-    bool formantPreserved = (currentOptions & RubberBand::RubberBandStretcher::OptionFormantPreserved) != 0;
-
-    if ((mFormant > 50.0f && !formantPreserved) ||
-        (mFormant <= 50.0f && formantPreserved)) {
-        ReconfigureStretcher();
+    // The engine renders exactly the channel layout it was prepared with
+    const UInt32 numInputChannels = mEngine.GetNumInputChannels();
+    const UInt32 numOutputChannels = mEngine.GetNumOutputChannels();
+    if (inBuffer.mNumberBuffers < numInputChannels || outBuffer.mNumberBuffers < numOutputChannels) {
+        return kAudioUnitErr_FormatNotSupported;
     }
 
-    // Get channel counts
-    const UInt32 numInputChannels = inBuffer.mNumberBuffers;
-    const UInt32 numOutputChannels = outBuffer.mNumberBuffers;
-
-    // Process the input through RubberBand
     for (UInt32 channel = 0; channel < numInputChannels; ++channel) {
-        float* inputData = static_cast<float*>(inBuffer.mBuffers[channel].mData);
-        mStretcher->process(&inputData, inFramesToProcess, false);
+        mInputBuffers[channel] = static_cast<const float*>(inBuffer.mBuffers[channel].mData);
     }
-
-    // Retrieve available output
-    const UInt32 available = mStretcher->available();
-    if (available > 0) {
-        // Create temporary output buffers for RubberBand
-        std::vector<float*> outputPtrs(numOutputChannels);
-        for (UInt32 channel = 0; channel < numOutputChannels; ++channel) {
-            outputPtrs[channel] = static_cast<float*>(outBuffer.mBuffers[channel].mData);
-        }
-
-        // Retrieve output from RubberBand
-        mStretcher->retrieve(outputPtrs.data(), available);
-
-        // Apply wet/dry mix if not 100% wet
-        if (mMix < 100.0f) {
-            const float wet = mMix / 100.0f;
-            const float dry = 1.0f - wet;
-
-            for (UInt32 channel = 0; channel < numInputChannels && channel < numOutputChannels; ++channel) {
-                float* inputData = static_cast<float*>(inBuffer.mBuffers[channel].mData);
-                float* outputData = static_cast<float*>(outBuffer.mBuffers[channel].mData);
-
-                for (UInt32 frame = 0; frame < inFramesToProcess && frame < available; ++frame) {
-                    outputData[frame] = wet * outputData[frame] + dry * inputData[frame];
-                }
-            }
-        }
-    } else {
-        // No output available yet, pass through the input
-        for (UInt32 channel = 0; channel < numInputChannels && channel < numOutputChannels; ++channel) {
-            float* inputData = static_cast<float*>(inBuffer.mBuffers[channel].mData);
-            float* outputData = static_cast<float*>(outBuffer.mBuffers[channel].mData);
-
-            memcpy(outputData, inputData, inFramesToProcess * sizeof(float));
-        }
+    for (UInt32 channel = 0; channel < numOutputChannels; ++channel) {
+        mOutputBuffers[channel] = static_cast<float*>(outBuffer.mBuffers[channel].mData);
     }
 
+    mEngine.Process(mInputBuffers.data(), mOutputBuffers.data(), inFramesToProcess);
+
     return noErr;
 }
 
@@ -182,8 +125,33 @@ OSStatus PolyphonicPitchShifter::ProcessBufferLists(
 OSStatus PolyphonicPitchShifter::GetParameterValueStrings(AudioUnitScope inScope,
                                                         AudioUnitParameterID inParameterID,
                                                         CFArrayRef* outStrings) {
-    // We don't use parameter strings
-    return kAudioUnitErr_InvalidProperty;
+    // Only the latency and stereo modes are indexed parameters
+    if (inScope != kAudioUnitScope_Global ||
+        (inParameterID != kParam_Latency && inParameterID != kParam_StereoMode)) {
+        return kAudioUnitErr_InvalidProperty;
+    }
+    if (!outStrings) {
+        return noErr;
+    }
+
+    static const CFStringRef sLatencyModeNames[kNumberOfLatencyModes] = {
+        CFSTR("High Quality"),
+        CFSTR("Low Latency"),
+        CFSTR("Live")
+    };
+    static const CFStringRef sStereoModeNames[kNumberOfStereoModes] = {
+        CFSTR("Independent"),
+        CFSTR("Mid/Side"),
+        CFSTR("Mono")
+    };
+    if (inParameterID == kParam_Latency) {
+        *outStrings = CFArrayCreate(nullptr, reinterpret_cast<const void**>(sLatencyModeNames),
+                                    kNumberOfLatencyModes, nullptr);
+    } else {
+        *outStrings = CFArrayCreate(nullptr, reinterpret_cast<const void**>(sStereoModeNames),
+                                    kNumberOfStereoModes, nullptr);
+    }
+    return noErr;
 }
 
 // Get parameter info
@@ -199,6 +167,48 @@ OSStatus PolyphonicPitchShifter::GetParameterInfo(AudioUnitScope inScope,
     AudioUnitParameterInfo& info = outParameterInfo;
     info.flags = kAudioUnitParameterFlag_IsWritable | kAudioUnitParameterFlag_IsReadable;
 
+    // Harmony voices: kParamsPerVoice parameters each
+    if (IsVoiceParameter(inParameterID)) {
+        static const CFStringRef sVoiceParameterNames[kNumberOfHarmonyVoices][kParamsPerVoice] = {
+            { CFSTR("Voice 1 Interval"), CFSTR("Voice 1 Level"), CFSTR("Voice 1 Pan") },
+            { CFSTR("Voice 2 Interval"), CFSTR("Voice 2 Level"), CFSTR("Voice 2 Pan") },
+            { CFSTR("Voice 3 Interval"), CFSTR("Voice 3 Level"), CFSTR("Voice 3 Pan") },
+            { CFSTR("Voice 4 Interval"), CFSTR("Voice 4 Level"), CFSTR("Voice 4 Pan") },
+            { CFSTR("Voice 5 Interval"), CFSTR("Voice 5 Level"), CFSTR("Voice 5 Pan") },
+            { CFSTR("Voice 6 Interval"), CFSTR("Voice 6 Level"), CFSTR("Voice 6 Pan") },
+            { CFSTR("Voice 7 Interval"), CFSTR("Voice 7 Level"), CFSTR("Voice 7 Pan") },
+            { CFSTR("Voice 8 Interval"), CFSTR("Voice 8 Level"), CFSTR("Voice 8 Pan") }
+        };
+        const UInt32 voice = (inParameterID - kParam_FirstVoice) / kParamsPerVoice;
+        const UInt32 voiceParam = (inParameterID - kParam_FirstVoice) % kParamsPerVoice;
+        info.name = sVoiceParameterNames[voice][voiceParam];
+        info.defaultValue = kParameterDefaults[inParameterID];
+
+        switch (voiceParam) {
+            case kVoiceParam_Interval:
+                info.unitName = CFSTR("semitones");
+                info.minValue = kMinVoiceInterval;
+                info.maxValue = kMaxVoiceInterval;
+                info.unit = kAudioUnitParameterUnit_RelativeSemiTones;
+                break;
+
+            case kVoiceParam_Level:
+                info.unitName = CFSTR("%");
+                info.minValue = kMinVoiceLevel;
+                info.maxValue = kMaxVoiceLevel;
+                info.unit = kAudioUnitParameterUnit_Percent;
+                break;
+
+            default:
+                info.unitName = nullptr;
+                info.minValue = kMinVoicePan;
+                info.maxValue = kMaxVoicePan;
+                info.unit = kAudioUnitParameterUnit_Pan;
+                break;
+        }
+        return noErr;
+    }
+
     switch (inParameterID) {
         case kParam_PitchShift:
             info.name = CFSTR("Pitch Shift");
@@ -227,15 +237,80 @@ OSStatus PolyphonicPitchShifter::GetParameterInfo(AudioUnitScope inScope,
             info.unit = kAudioUnitParameterUnit_Percent;
             break;
 
-        case kParam_Latency:
-            info.name = CFSTR("Low Latency Mode");
+        case kParam_LegacyLowLatency:
+            info.name = CFSTR("Low Latency Mode (Legacy)");
             info.unitName = CFSTR("%");
-            info.minValue = 0.0f;
-            info.maxValue = 100.0f;
-            info.defaultValue = kDefaultLatency;
+            info.minValue = kMinLegacyLowLatency;
+            info.maxValue = kMaxLegacyLowLatency;
+            info.defaultValue = kDefaultLegacyLowLatency;
             info.unit = kAudioUnitParameterUnit_Percent;
             break;
 
+        case kParam_Latency:
+            info.name = CFSTR("Latency Mode");
+            info.unitName = nullptr;
+            info.minValue = kMinLatency;
+            info.maxValue = kMaxLatency;
+            info.defaultValue = kDefaultLatency;
+            info.unit = kAudioUnitParameterUnit_Indexed;
+            info.flags |= kAudioUnitParameterFlag_ValuesHaveStrings;
+            break;
+
+        case kParam_StereoMode:
+            info.name = CFSTR("Stereo Mode");
+            info.unitName = nullptr;
+            info.minValue = kMinStereoMode;
+            info.maxValue = kMaxStereoMode;
+            info.defaultValue = kDefaultStereoMode;
+            info.unit = kAudioUnitParameterUnit_Indexed;
+            info.flags |= kAudioUnitParameterFlag_ValuesHaveStrings;
+            break;
+
+        case kParam_BandSplit:
+            info.name = CFSTR("Low String Band Split");
+            info.unitName = nullptr;
+            info.minValue = kMinBandSplit;
+            info.maxValue = kMaxBandSplit;
+            info.defaultValue = kDefaultBandSplit;
+            info.unit = kAudioUnitParameterUnit_Boolean;
+            break;
+
+        case kParam_Crossover:
+            info.name = CFSTR("Crossover");
+            info.unitName = CFSTR("Hz");
+            info.minValue = kMinCrossover;
+            info.maxValue = kMaxCrossover;
+            info.defaultValue = kDefaultCrossover;
+            info.unit = kAudioUnitParameterUnit_Hertz;
+            break;
+
+        case kParam_HarmonyVoices:
+            info.name = CFSTR("Harmony Voices");
+            info.unitName = nullptr;
+            info.minValue = kMinHarmonyVoices;
+            info.maxValue = kMaxHarmonyVoices;
+            info.defaultValue = kDefaultHarmonyVoices;
+            info.unit = kAudioUnitParameterUnit_Indexed;
+            break;
+
+        case kParam_Adaptive:
+            info.name = CFSTR("Adaptive Engine");
+            info.unitName = nullptr;
+            info.minValue = kMinAdaptive;
+            info.maxValue = kMaxAdaptive;
+            info.defaultValue = kDefaultAdaptive;
+            info.unit = kAudioUnitParameterUnit_Boolean;
+            break;
+
+        case kParam_ZeroLatencyDry:
+            info.name = CFSTR("Zero-Latency Dry");
+            info.unitName = nullptr;
+            info.minValue = kMinZeroLatencyDry;
+            info.maxValue = kMaxZeroLatencyDry;
+            info.defaultValue = kDefaultZeroLatencyDry;
+            info.unit = kAudioUnitParameterUnit_Boolean;
+            break;
+
         default:
             return kAudioUnitErr_InvalidParameter;
     }
@@ -249,6 +324,14 @@ OSStatus PolyphonicPitchShifter::GetPropertyInfo(AudioUnitPropertyID inID,
                                               AudioUnitElement inElement,
                                               UInt32& outDataSize,
                                               bool& outWritable) {
+    if (inID == kPitchShifterProperty_RenderStats) {
+        if (inScope != kAudioUnitScope_Global) {
+            return kAudioUnitErr_InvalidScope;
+        }
+        outDataSize = sizeof(RenderStatsSnapshot);
+        outWritable = true;
+        return noErr;
+    }
     return ausdk::AUEffectBase::GetPropertyInfo(inID, inScope, inElement, outDataSize, outWritable);
 }
 
@@ -257,40 +340,61 @@ OSStatus PolyphonicPitchShifter::GetProperty(AudioUnitPropertyID inID,
                                           AudioUnitScope inScope,
                                           AudioUnitElement inElement,
                                           void* outData) {
+    if (inID == kPitchShifterProperty_RenderStats) {
+        if (inScope != kAudioUnitScope_Global) {
+            return kAudioUnitErr_InvalidScope;
+        }
+        // Lock-free snapshot; safe while the render thread runs
+        mEngine.GetRenderStats(*static_cast<RenderStatsSnapshot*>(outData));
+        return noErr;
+    }
     return ausdk::AUEffectBase::GetProperty(inID, inScope, inElement, outData);
 }
 
+// Set property
+OSStatus PolyphonicPitchShifter::SetProperty(AudioUnitPropertyID inID,
+                                          AudioUnitScope inScope,
+                                          AudioUnitElement inElement,
+                                          const void* inData,
+                                          UInt32 inDataSize) {
+    if (inID == kPitchShifterProperty_RenderStats) {
+        if (inScope != kAudioUnitScope_Global) {
+            return kAudioUnitErr_InvalidScope;
+        }
+        mEngine.ClearRenderStats();
+        return noErr;
+    }
+    return ausdk::AUEffectBase::SetProperty(inID, inScope, inElement, inData, inDataSize);
+}
+
 // Set parameter
 OSStatus PolyphonicPitchShifter::SetParameter(AudioUnitParameterID inID,
                                            AudioUnitScope inScope,
                                            AudioUnitElement inElement,
                                            AudioUnitParameterValue inValue,
                                            UInt32 inBufferOffsetInFrames) {
-    // Update our parameter values and flag for reconfiguration
-    switch (inID) {
-        case kParam_PitchShift:
-            mPitchShift = inValue;
-            mNeedReconfiguration = true;
-            break;
-
-        case kParam_Mix:
-            mMix = inValue;
-            break;
+    if (inID >= kNumberOfParameters) {
+        return kAudioUnitErr_InvalidParameter;
+    }
 
-        case kParam_Formant:
-            mFormant = inValue;
-            mNeedReconfiguration = true;
-            break;
+    // Hand the new value to the engine; it is applied on the render thread,
+    // inBufferOffsetInFrames into the next rendered block
+    mEngine.SetParameter(inID, inValue, inBufferOffsetInFrames);
 
-        case kParam_Latency:
-            mLatency = inValue;
-            mNeedReconfiguration = true;
-            break;
-
-        default:
-            return kAudioUnitErr_InvalidParameter;
+    // Call the base class implementation
+    OSStatus result = ausdk::AUEffectBase::SetParameter(inID, inScope, inElement, inValue, inBufferOffsetInFrames);
+
+    // The engine turns the legacy setting into a tier; show the host that
+    // tier too. Sessions restore parameters in ID order, so a saved tier
+    // still overrides its legacy value.
+    if (result == noErr && inID == kParam_LegacyLowLatency) {
+        inID = kParam_Latency;
+        result = ausdk::AUEffectBase::SetParameter(inID, inScope, inElement, mEngine.GetParameter(kParam_Latency),
+                                                   inBufferOffsetInFrames);
     }
 
-    // Call the base class implementation
-    return ausdk::AUEffectBase::SetParameter(inID, inScope, inElement, inValue, inBufferOffsetInFrames);
+    // A new tier, band split, harmonizer or adaptive switch changes the
+    // delay the host compensates for; the engine reports it from its worker
+    // (see LatencyChanged()), since this may be the render thread
+    return result;
 }
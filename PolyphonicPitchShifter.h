@@ -2,13 +2,10 @@
 #include "AudioUnitSDK/AUEffectBase.h" // Includes AUBase.h, AUBuffer.h, AUUtility.h, AUPlugInDispatch.h, etc.
 
 // Standard library headers
-#include <mutex>
 #include <vector>
-#include <memory>
-#include <cmath> // Moved cmath here from cpp
 
-// Third-party library headers
-#include <rubberband/RubberBandStretcher.h> // Includes its own headers
+// Portable DSP core (owns the RubberBand stretcher and parameter state)
+#include "PitchShifterEngine.h"
 
 // Conditional includes
 #if AU_DEBUG_DISPATCHER
@@ -19,47 +16,33 @@
 #ifndef __PolyphonicPitchShifter_h__
 #define __PolyphonicPitchShifter_h__
 
-// Custom parameters for our plugin
+// Custom properties (global scope)
 enum {
-    kParam_PitchShift = 0,  // -12 to +12 semitones
-    kParam_Mix,            // Dry/wet mix (0-100%)
-    kParam_Formant,        // Formant preservation (0-100%)
-    kParam_Latency,        // Latency mode (0=lowest possible, 1=higher quality)
-    kNumberOfParameters
+    // RenderStatsSnapshot; read to get the render statistics, write
+    // anything to clear them
+    kPitchShifterProperty_RenderStats = 64000
 };
 
-// Parameter ranges
-const float kMinPitchShift = -12.0f;
-const float kMaxPitchShift = 12.0f;
-const float kDefaultPitchShift = 0.0f;
-
-const float kMinMix = 0.0f;
-const float kMaxMix = 100.0f;
-const float kDefaultMix = 100.0f;
-
-const float kMinFormant = 0.0f;
-const float kMaxFormant = 100.0f;
-const float kDefaultFormant = 0.0f;
-
-const float kMinLatency = 0.0f;
-const float kMaxLatency = 1.0f;
-const float kDefaultLatency = 0.0f;
-
-class PolyphonicPitchShifter : public AUEffectBase
+class PolyphonicPitchShifter : public ausdk::AUEffectBase
 {
 public:
-    PolyphonicPitchShifter(AudioUnit component);
-    virtual ~PolyphonicPitchShifter() {}
+    PolyphonicPitchShifter(AudioComponentInstance inComponentInstance);
+    virtual ~PolyphonicPitchShifter();
 
     // Required AUEffectBase overrides
     virtual OSStatus Initialize();
     virtual void Cleanup();
+    virtual UInt32 SupportedNumChannels(const AUChannelInfo** outInfo);
     virtual OSStatus Reset(AudioUnitScope inScope, AudioUnitElement inElement);
+    virtual OSStatus ProcessBufferLists(AudioUnitRenderActionFlags& ioActionFlags,
+                                        const AudioBufferList& inBuffer,
+                                        AudioBufferList& outBuffer,
+                                        UInt32 inFramesToProcess);
     virtual OSStatus GetPropertyInfo(AudioUnitPropertyID inID,
                                      AudioUnitScope inScope,
                                      AudioUnitElement inElement,
                                      UInt32& outDataSize,
-                                     Boolean& outWritable);
+                                     bool& outWritable);
     virtual OSStatus GetProperty(AudioUnitPropertyID inID,
                                  AudioUnitScope inScope,
                                  AudioUnitElement inElement,
@@ -69,57 +52,37 @@ public:
                                  AudioUnitElement inElement,
                                  const void* inData,
                                  UInt32 inDataSize);
-    virtual OSStatus GetParameterInfo(AudioUnitParameterID inID,
+    virtual OSStatus GetParameterValueStrings(AudioUnitScope inScope,
+                                              AudioUnitParameterID inParameterID,
+                                              CFArrayRef* outStrings);
+    virtual OSStatus GetParameterInfo(AudioUnitScope inScope,
+                                      AudioUnitParameterID inParameterID,
                                       AudioUnitParameterInfo& outParameterInfo);
-    virtual OSStatus GetParameter(AudioUnitParameterID inID,
+    virtual OSStatus SetParameter(AudioUnitParameterID inID,
                                   AudioUnitScope inScope,
                                   AudioUnitElement inElement,
-                                  Float32& outValue);
-    virtual OSStatus SetParameter(AudioUnitParameterID inID,
-                                        AudioUnitScope inScope,
-                                        AudioUnitElement inElement,
-                                        Float32 inValue,
-                                        UInt32 inBufferOffsetInFrames);
+                                  AudioUnitParameterValue inValue,
+                                  UInt32 inBufferOffsetInFrames);
 
     // Required factory method
-    static OSStatus CreateEffectInstance(ComponentInstanceRecord* inInstance);
+    static OSStatus CreateEffectInstance(AudioComponentInstance inInstance);
 
     // For Cocoa UI?
     virtual bool SupportsTail() { return true; }
     virtual Float64 GetTailTime() { return 0.5; }
-    virtual Float64 GetLatency() { return mLatency; }
+    virtual Float64 GetLatency() { return mEngine.GetLatencySeconds(); }
 
 private:
-    // RubberBand implementation
-    void initializeRubberBand();
-    void resetRubberBand();
-    void updateRubberBandParameters();
-
-    // Parameters
-    float mPitchShift;
-    float mMix;
-    float mFormant;
-    float mLatencyMode;
+    // Tells the host's latency listeners; called by the engine off the
+    // render thread
+    static void LatencyChanged(void* inContext);
 
-    // RubberBand stretcher
-    std::unique_ptr<RubberBand::RubberBandStretcher> mStretcher;
+    // DSP core
+    PitchShifterEngine mEngine;
 
-    // Processing buffers
-    std::vector<float> mInputBufferL;
-    std::vector<float> mInputBufferR;
-    std::vector<float> mOutputBufferL;
-    std::vector<float> mOutputBufferR;
-
-    std::vector<float*> mInputBuffers;
+    // Per-channel pointer tables handed to the engine, sized in Initialize()
+    std::vector<const float*> mInputBuffers;
     std::vector<float*> mOutputBuffers;
-
-    // States
-    bool mNeedsReset;
-    bool mIsInitialized;
-    double mLatency;
-    double mSampleRate;
-    UInt32 mMaxFramesToProcess;
-    std::mutex mProcessMutex;
 };
 
 #endif /* __PolyphonicPitchShifter_h__ */
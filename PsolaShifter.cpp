@@ -0,0 +1,192 @@
+#include "PsolaShifter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Detector aperiodicity below which the input counts as voiced
+const float kVoicedThreshold = 0.2f;
+
+// Grain spacing for unvoiced input
+const double kUnvoicedSeconds = 0.005;
+
+// Frames processed per pass; bounds how far the rings reach
+const uint32_t kChunkFrames = 256;
+
+// Window sum below which the output is not scaled up any further (grain
+// edges at the longest periods, and the very start)
+const float kMinWindowSum = 0.5f;
+
+} // namespace
+
+// Constructor
+PsolaShifter::PsolaShifter()
+    : mHasEstimate(false),
+      mEstimatePeriod(0.0),
+      mEstimateAperiodicity(1.0f),
+      mRingFrames(0),
+      mRingMask(0),
+      mWindowHalfGrain(0),
+      mFrameIndex(0),
+      mAnalysisMark(0.0),
+      mSynthesisMark(0.0),
+      mLatencyFrames(0),
+      mMaxHalfGrain(1),
+      mUnvoicedPeriod(1.0),
+      mNumChannels(0),
+      mPitchScale(1.0)
+{
+}
+
+void PsolaShifter::Prepare(double inSampleRate, uint32_t inNumChannels) {
+    mNumChannels = inNumChannels;
+    mDetector.Prepare(inSampleRate, inNumChannels);
+    mMaxHalfGrain = mDetector.GetMaxPeriodFrames();
+    mLatencyFrames = 2 * mMaxHalfGrain + 2;
+    mUnvoicedPeriod = std::min<double>(mMaxHalfGrain, std::max(1.0, kUnvoicedSeconds * inSampleRate));
+
+    // A grain reads up to a period before its analysis mark, which itself
+    // moves back up to a period, and writes up to a grain beyond the newest
+    // frame
+    const uint32_t reach = kChunkFrames + mLatencyFrames + 3 * mMaxHalfGrain + 4;
+    mRingFrames = 1;
+    while (mRingFrames < reach) {
+        mRingFrames <<= 1;
+    }
+    mRingMask = mRingFrames - 1;
+    mInput.assign(static_cast<size_t>(inNumChannels) * mRingFrames, 0.0f);
+    mOutput.assign(static_cast<size_t>(inNumChannels) * mRingFrames, 0.0f);
+    mWindowSum.assign(mRingFrames, 0.0f);
+    mGrainWindow.assign(2 * mMaxHalfGrain, 0.0f);
+    mWindowHalfGrain = 0;
+    mChunkPtrs.resize(inNumChannels);
+
+    Reset();
+}
+
+void PsolaShifter::Reset() {
+    mDetector.Reset();
+    mHasEstimate = false;
+    std::fill(mInput.begin(), mInput.end(), 0.0f);
+    std::fill(mOutput.begin(), mOutput.end(), 0.0f);
+    std::fill(mWindowSum.begin(), mWindowSum.end(), 0.0f);
+    mFrameIndex = 0;
+    mSynthesisMark = 0.0;
+    mAnalysisMark = -static_cast<double>(mLatencyFrames);
+}
+
+void PsolaShifter::SetPitchEstimate(double inPeriodFrames, float inAperiodicity) {
+    mHasEstimate = true;
+    mEstimatePeriod = inPeriodFrames;
+    mEstimateAperiodicity = inAperiodicity;
+}
+
+void PsolaShifter::Process(const float* const* inInputs, float* const* outOutputs, uint32_t inFrames) {
+    for (uint32_t done = 0; done < inFrames; ) {
+        const uint32_t frames = std::min(inFrames - done, kChunkFrames);
+        const int64_t firstFrame = mFrameIndex;
+
+        for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+            const float* input = inInputs[channel] + done;
+            float* ring = mInput.data() + static_cast<size_t>(channel) * mRingFrames;
+            for (uint32_t frame = 0; frame < frames; ++frame) {
+                ring[(firstFrame + frame) & mRingMask] = input[frame];
+            }
+            mChunkPtrs[channel] = input;
+        }
+        if (!mHasEstimate) {
+            mDetector.Process(mChunkPtrs.data(), frames);
+        }
+        mFrameIndex += frames;
+
+        const double period = std::min<double>(mHasEstimate ? mEstimatePeriod : mDetector.GetPeriodFrames(),
+                                               mMaxHalfGrain);
+        const float aperiodicity = mHasEstimate ? mEstimateAperiodicity : mDetector.GetAperiodicity();
+        const bool voiced = period >= 1.0 && aperiodicity < kVoicedThreshold;
+        const double analysisPeriod = voiced ? period : mUnvoicedPeriod;
+        const double synthesisPeriod = voiced ? period / mPitchScale : mUnvoicedPeriod;
+        const uint32_t halfGrain = std::clamp<uint32_t>(static_cast<uint32_t>(lround(synthesisPeriod)), 1,
+                                                        mMaxHalfGrain);
+        if (halfGrain != mWindowHalfGrain) {
+            const double step = M_PI / halfGrain;
+            for (uint32_t i = 0; i < 2 * halfGrain; ++i) {
+                mGrainWindow[i] = static_cast<float>(0.5 - 0.5 * std::cos(step * i));
+            }
+            mWindowHalfGrain = halfGrain;
+        }
+
+        // Every grain reaching into the frames to emit. Each synthesis mark
+        // takes the latest analysis mark at or before its own position one
+        // latency earlier, moved onto the waveform peak; unshifted grains
+        // take exactly that position, so unvoiced input and unison come out
+        // as a plain delay.
+        const bool shifting = voiced && mPitchScale != 1.0;
+        while (mSynthesisMark - halfGrain < mFrameIndex) {
+            const double target = mSynthesisMark - mLatencyFrames;
+            if (!shifting || target - mAnalysisMark > 4.0 * analysisPeriod) {
+                mAnalysisMark = target;
+            }
+            while (mAnalysisMark + analysisPeriod <= target) {
+                mAnalysisMark += analysisPeriod;
+            }
+            const int64_t analysisMark = llround(mAnalysisMark);
+            AddGrain(shifting ? FindPitchMark(analysisMark, static_cast<uint32_t>(lround(analysisPeriod)))
+                              : analysisMark,
+                     llround(mSynthesisMark), halfGrain, firstFrame);
+            mSynthesisMark += synthesisPeriod;
+        }
+
+        // Hand out the finished frames normalized by the window sum,
+        // clearing them for the next lap of the ring
+        for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+            float* output = mOutput.data() + static_cast<size_t>(channel) * mRingFrames;
+            for (uint32_t frame = 0; frame < frames; ++frame) {
+                const uint32_t position = static_cast<uint32_t>(firstFrame + frame) & mRingMask;
+                outOutputs[channel][done + frame] = output[position] / std::max(mWindowSum[position], kMinWindowSum);
+                output[position] = 0.0f;
+            }
+        }
+        for (uint32_t frame = 0; frame < frames; ++frame) {
+            mWindowSum[(firstFrame + frame) & mRingMask] = 0.0f;
+        }
+        done += frames;
+    }
+}
+
+int64_t PsolaShifter::FindPitchMark(int64_t inMark, uint32_t inPeriod) const {
+    int64_t best = inMark;
+    float bestPeak = -1.0f;
+    for (uint32_t back = 0; back < inPeriod; ++back) {
+        float peak = 0.0f;
+        for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+            peak += std::fabs(mInput[static_cast<size_t>(channel) * mRingFrames + ((inMark - back) & mRingMask)]);
+        }
+        if (peak > bestPeak) {
+            bestPeak = peak;
+            best = inMark - back;
+        }
+    }
+    return best;
+}
+
+void PsolaShifter::AddGrain(int64_t inAnalysisMark, int64_t inSynthesisMark, uint32_t inHalfGrain,
+                            int64_t inFirstFrame) {
+    const int64_t skip = std::max<int64_t>(0, inFirstFrame - (inSynthesisMark - inHalfGrain));
+    const uint32_t grainFrames = 2 * inHalfGrain;
+    if (skip >= grainFrames) {
+        return;
+    }
+
+    // mGrainWindow holds the Hann window for inHalfGrain
+    for (uint32_t i = static_cast<uint32_t>(skip); i < grainFrames; ++i) {
+        mWindowSum[(inSynthesisMark - inHalfGrain + i) & mRingMask] += mGrainWindow[i];
+    }
+    for (uint32_t channel = 0; channel < mNumChannels; ++channel) {
+        const float* input = mInput.data() + static_cast<size_t>(channel) * mRingFrames;
+        float* output = mOutput.data() + static_cast<size_t>(channel) * mRingFrames;
+        for (uint32_t i = static_cast<uint32_t>(skip); i < grainFrames; ++i) {
+            output[(inSynthesisMark - inHalfGrain + i) & mRingMask] +=
+                mGrainWindow[i] * input[(inAnalysisMark - inHalfGrain + i) & mRingMask];
+        }
+    }
+}
@@ -0,0 +1,90 @@
+// Standard library headers
+#include <cstdint>
+#include <vector>
+
+#include "PitchDetector.h"
+
+// Include guards
+#ifndef __PsolaShifter_h__
+#define __PsolaShifter_h__
+
+// Pitch-synchronous overlap-add shifter for single-note material. A
+// PitchDetector tracks the period T of the folded input; Hann grains are cut
+// around analysis marks spaced T apart and laid down at synthesis marks
+// spaced T / pitch scale apart, repeating or skipping periods to keep up.
+// When shifting, each analysis mark moves back onto the loudest frame of the
+// period before it, so every grain is centred on the same point of the
+// waveform; grains span two synthesis periods, and the overlap-add is
+// divided by the sum of the windows laid down. Unvoiced input is passed through with unshifted 5 ms grains.
+// Formants stay where they are, and the cost is a few multiply-adds per
+// frame per channel plus the detector.
+//
+// Every channel shares the marks. The output is GetLatencyFrames() behind
+// the input (two of the longest detectable periods, so a grain never needs
+// input that hasn't arrived), and at unison it is the input delayed by that
+// much, to within the ripple of the rounded grain spacing.
+//
+// All storage is allocated in Prepare(); Process() never allocates.
+class PsolaShifter
+{
+public:
+    PsolaShifter();
+
+    void Prepare(double inSampleRate, uint32_t inNumChannels);
+    void Reset();
+
+    void SetPitchScale(double inPitchScale) { mPitchScale = inPitchScale; }
+
+    // Period and aperiodicity from a detector already fed with the same
+    // input, used instead of the built-in one until ClearPitchEstimate()
+    void SetPitchEstimate(double inPeriodFrames, float inAperiodicity);
+    void ClearPitchEstimate() { mHasEstimate = false; }
+
+    // inInputs and outOutputs hold GetNumChannels() buffers and may alias
+    void Process(const float* const* inInputs, float* const* outOutputs, uint32_t inFrames);
+
+    uint32_t GetNumChannels() const { return mNumChannels; }
+    uint32_t GetLatencyFrames() const { return mLatencyFrames; }
+
+private:
+    // The loudest input frame, summed over channels, in the inPeriod frames
+    // ending at inMark
+    int64_t FindPitchMark(int64_t inMark, uint32_t inPeriod) const;
+
+    // Overlap-adds the grain around input frame inAnalysisMark at output
+    // frame inSynthesisMark; output before inFirstFrame is already gone
+    void AddGrain(int64_t inAnalysisMark, int64_t inSynthesisMark, uint32_t inHalfGrain, int64_t inFirstFrame);
+
+    PitchDetector mDetector;
+    bool mHasEstimate;
+    double mEstimatePeriod;
+    float mEstimateAperiodicity;
+
+    // Input history and output accumulator, one power-of-two ring per
+    // channel, and the window sum under the output (shared by the channels)
+    std::vector<float> mInput;
+    std::vector<float> mOutput;
+    std::vector<float> mWindowSum;
+    uint32_t mRingFrames;
+    uint32_t mRingMask;
+
+    // Hann window for grains of mWindowHalfGrain, rebuilt when the grain
+    // length changes
+    std::vector<float> mGrainWindow;
+    uint32_t mWindowHalfGrain;
+    std::vector<const float*> mChunkPtrs;
+
+    // Frames received so far, and the next marks on that timeline
+    int64_t mFrameIndex;
+    double mAnalysisMark;
+    double mSynthesisMark;
+
+    // Fixed at Prepare()
+    uint32_t mLatencyFrames;
+    uint32_t mMaxHalfGrain;
+    double mUnvoicedPeriod;
+    uint32_t mNumChannels;
+    double mPitchScale;
+};
+
+#endif /* __PsolaShifter_h__ */
@@ -0,0 +1,151 @@
+#include "RenderStats.h"
+#include <algorithm>
+
+namespace {
+
+// Bin for a log2 histogram: 0 -> 0, 1 -> 1, 2-3 -> 2, 4-7 -> 3, ...
+uint32_t GetLog2Bin(uint64_t inValue, uint32_t inNumberOfBins) {
+    uint32_t bin = 0;
+    while (inValue != 0 && bin + 1 < inNumberOfBins) {
+        inValue >>= 1;
+        ++bin;
+    }
+    return bin;
+}
+
+} // namespace
+
+// Constructor
+RenderStats::RenderStats()
+    : mClearRequested(false)
+{
+    Clear();
+}
+
+// Single writer: load and store rather than a locked read-modify-write
+void RenderStats::Increment(Counter& ioCounter, uint64_t inAmount) {
+    ioCounter.store(ioCounter.load(std::memory_order_relaxed) + inAmount, std::memory_order_relaxed);
+}
+
+void RenderStats::Clear() {
+    mBlocks.store(0, std::memory_order_relaxed);
+    mFrames.store(0, std::memory_order_relaxed);
+    mTotalSeconds.store(0.0, std::memory_order_relaxed);
+    mWorstSeconds.store(0.0, std::memory_order_relaxed);
+    mLastBudgetRatio.store(0.0, std::memory_order_relaxed);
+    mWorstBudgetRatio.store(0.0, std::memory_order_relaxed);
+    mOverBudgetBlocks.store(0, std::memory_order_relaxed);
+    mStarvedBlocks.store(0, std::memory_order_relaxed);
+    mStarvedFrames.store(0, std::memory_order_relaxed);
+    mLastBufferedFrames.store(0, std::memory_order_relaxed);
+    mMinBufferedFrames.store(UINT32_MAX, std::memory_order_relaxed);
+    mRebuildRequests.store(0, std::memory_order_relaxed);
+    mSlotSwaps.store(0, std::memory_order_relaxed);
+    mSlotRestarts.store(0, std::memory_order_relaxed);
+    mIdleBlocks.store(0, std::memory_order_relaxed);
+    mWakeups.store(0, std::memory_order_relaxed);
+    mMissedDeadlines.store(0, std::memory_order_relaxed);
+    for (uint32_t bin = 0; bin < kNumberOfBins; ++bin) {
+        mBlockTimeHistogram[bin].store(0, std::memory_order_relaxed);
+        mBudgetRatioHistogram[bin].store(0, std::memory_order_relaxed);
+        mBufferedHistogram[bin].store(0, std::memory_order_relaxed);
+    }
+}
+
+void RenderStats::RequestClear() {
+    mClearRequested.store(true, std::memory_order_relaxed);
+}
+
+void RenderStats::RecordBlock(uint32_t inFrames, double inSeconds, double inBudgetSeconds, uint32_t inStarvedFrames,
+                              uint32_t inBufferedFrames) {
+    RecordTime(inFrames, inSeconds, inBudgetSeconds);
+
+    if (inStarvedFrames > 0) {
+        Increment(mStarvedBlocks);
+        Increment(mStarvedFrames, inStarvedFrames);
+    }
+
+    mLastBufferedFrames.store(inBufferedFrames, std::memory_order_relaxed);
+    if (inBufferedFrames < mMinBufferedFrames.load(std::memory_order_relaxed)) {
+        mMinBufferedFrames.store(inBufferedFrames, std::memory_order_relaxed);
+    }
+    Increment(mBufferedHistogram[GetLog2Bin(inBufferedFrames, kNumberOfBins)]);
+}
+
+void RenderStats::RecordIdleBlock(uint32_t inFrames, double inSeconds, double inBudgetSeconds) {
+    RecordTime(inFrames, inSeconds, inBudgetSeconds);
+    Increment(mIdleBlocks);
+}
+
+void RenderStats::RecordTime(uint32_t inFrames, double inSeconds, double inBudgetSeconds) {
+    if (mClearRequested.load(std::memory_order_relaxed)) {
+        mClearRequested.store(false, std::memory_order_relaxed);
+        Clear();
+    }
+
+    const double ratio = (inBudgetSeconds > 0.0) ? inSeconds / inBudgetSeconds : 0.0;
+
+    Increment(mBlocks);
+    Increment(mFrames, inFrames);
+    mTotalSeconds.store(mTotalSeconds.load(std::memory_order_relaxed) + inSeconds, std::memory_order_relaxed);
+    if (inSeconds > mWorstSeconds.load(std::memory_order_relaxed)) {
+        mWorstSeconds.store(inSeconds, std::memory_order_relaxed);
+    }
+    mLastBudgetRatio.store(ratio, std::memory_order_relaxed);
+    if (ratio > mWorstBudgetRatio.load(std::memory_order_relaxed)) {
+        mWorstBudgetRatio.store(ratio, std::memory_order_relaxed);
+    }
+    if (ratio > 1.0) {
+        Increment(mOverBudgetBlocks);
+    }
+
+    Increment(mBlockTimeHistogram[GetLog2Bin(static_cast<uint64_t>(inSeconds * 1e6), kNumberOfBins)]);
+    Increment(mBudgetRatioHistogram[std::min<uint32_t>(static_cast<uint32_t>(ratio * 8.0), kNumberOfBins - 1)]);
+}
+
+void RenderStats::RecordRebuildRequest() {
+    Increment(mRebuildRequests);
+}
+
+void RenderStats::RecordSlotSwap(bool inRestarted) {
+    Increment(mSlotSwaps);
+    if (inRestarted) {
+        Increment(mSlotRestarts);
+    }
+}
+
+void RenderStats::RecordWake() {
+    Increment(mWakeups);
+}
+
+void RenderStats::RecordMissedDeadline() {
+    Increment(mMissedDeadlines);
+}
+
+void RenderStats::Snapshot(RenderStatsSnapshot& outSnapshot) const {
+    outSnapshot.version = RenderStatsSnapshot::kVersion;
+    outSnapshot.reserved = 0;
+    outSnapshot.blocks = mBlocks.load(std::memory_order_relaxed);
+    outSnapshot.frames = mFrames.load(std::memory_order_relaxed);
+    outSnapshot.totalSeconds = mTotalSeconds.load(std::memory_order_relaxed);
+    outSnapshot.worstSeconds = mWorstSeconds.load(std::memory_order_relaxed);
+    outSnapshot.lastBudgetRatio = mLastBudgetRatio.load(std::memory_order_relaxed);
+    outSnapshot.worstBudgetRatio = mWorstBudgetRatio.load(std::memory_order_relaxed);
+    outSnapshot.overBudgetBlocks = mOverBudgetBlocks.load(std::memory_order_relaxed);
+    outSnapshot.starvedBlocks = mStarvedBlocks.load(std::memory_order_relaxed);
+    outSnapshot.starvedFrames = mStarvedFrames.load(std::memory_order_relaxed);
+    outSnapshot.lastBufferedFrames = mLastBufferedFrames.load(std::memory_order_relaxed);
+    const uint32_t minBuffered = mMinBufferedFrames.load(std::memory_order_relaxed);
+    outSnapshot.minBufferedFrames = (minBuffered == UINT32_MAX) ? 0 : minBuffered;
+    outSnapshot.rebuildRequests = mRebuildRequests.load(std::memory_order_relaxed);
+    outSnapshot.slotSwaps = mSlotSwaps.load(std::memory_order_relaxed);
+    outSnapshot.slotRestarts = mSlotRestarts.load(std::memory_order_relaxed);
+    outSnapshot.idleBlocks = mIdleBlocks.load(std::memory_order_relaxed);
+    outSnapshot.wakeups = mWakeups.load(std::memory_order_relaxed);
+    outSnapshot.missedDeadlines = mMissedDeadlines.load(std::memory_order_relaxed);
+    for (uint32_t bin = 0; bin < kNumberOfBins; ++bin) {
+        outSnapshot.blockTimeHistogram[bin] = mBlockTimeHistogram[bin].load(std::memory_order_relaxed);
+        outSnapshot.budgetRatioHistogram[bin] = mBudgetRatioHistogram[bin].load(std::memory_order_relaxed);
+        outSnapshot.bufferedHistogram[bin] = mBufferedHistogram[bin].load(std::memory_order_relaxed);
+    }
+}
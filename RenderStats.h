@@ -0,0 +1,126 @@
+// Standard library headers
+#include <atomic>
+#include <cstdint>
+
+// Include guards
+#ifndef __RenderStats_h__
+#define __RenderStats_h__
+
+// Plain copy of the render statistics, laid out for the AU property and the
+// tools. Totals count from the last Prepare() or clear.
+struct RenderStatsSnapshot
+{
+    static const uint32_t kVersion = 3;
+    static const uint32_t kNumberOfBins = 16;
+
+    uint32_t version;
+    uint32_t reserved;
+
+    // Blocks rendered and their cost
+    uint64_t blocks;
+    uint64_t frames;
+    double totalSeconds;
+    double worstSeconds;
+    double lastBudgetRatio;      // Render time over block duration
+    double worstBudgetRatio;
+    uint64_t overBudgetBlocks;   // Ratio above one
+
+    // Blocks where a stretcher had not produced the wet frames in time, and
+    // how many frames were padded with silence
+    uint64_t starvedBlocks;
+    uint64_t starvedFrames;
+
+    // Wet frames buffered beyond the block just read
+    uint32_t lastBufferedFrames;
+    uint32_t minBufferedFrames;
+
+    // Reconfiguration: rebuilds requested, replacement stretchers faded in,
+    // and how many of those had to restart from silence
+    uint64_t rebuildRequests;
+    uint64_t slotSwaps;
+    uint64_t slotRestarts;
+
+    // Blocks bypassed by the idle gate, and how often it woke up
+    uint64_t idleBlocks;
+    uint64_t wakeups;
+
+    // Pool tasks that missed their deadline; the wet signal is silence (and
+    // counted as starved) until they finish
+    uint64_t missedDeadlines;
+
+    // Block time in microseconds, log2 bins: 0, 1, 2-3, 4-7, ... (last bin
+    // open-ended)
+    uint64_t blockTimeHistogram[kNumberOfBins];
+
+    // Budget ratio in eighths: [0, 0.125), [0.125, 0.25), ... (last bin
+    // open-ended, anything from 1.875)
+    uint64_t budgetRatioHistogram[kNumberOfBins];
+
+    // Buffered wet frames per block, log2 bins like the block time
+    uint64_t bufferedHistogram[kNumberOfBins];
+};
+
+// Render-thread instrumentation. The render thread is the only writer and
+// updates plain atomics with relaxed loads and stores, so recording a block
+// costs two clock reads and a few dozen uncontended stores; it never locks
+// or allocates. Snapshot() may run on any thread at any time; fields of one
+// snapshot may straddle a block.
+class RenderStats
+{
+public:
+    RenderStats();
+
+    // Not concurrent with the Record calls
+    void Clear();
+
+    // Any thread: the render thread clears everything before its next block
+    void RequestClear();
+
+    // Render thread
+    void RecordBlock(uint32_t inFrames, double inSeconds, double inBudgetSeconds, uint32_t inStarvedFrames,
+                     uint32_t inBufferedFrames);
+    void RecordRebuildRequest();
+    void RecordSlotSwap(bool inRestarted);
+
+    // A block the idle gate bypassed: timed, but no stretcher to watch
+    void RecordIdleBlock(uint32_t inFrames, double inSeconds, double inBudgetSeconds);
+    void RecordWake();
+    void RecordMissedDeadline();
+
+    // Any thread
+    void Snapshot(RenderStatsSnapshot& outSnapshot) const;
+
+private:
+    static const uint32_t kNumberOfBins = RenderStatsSnapshot::kNumberOfBins;
+
+    using Counter = std::atomic<uint64_t>;
+    using Value = std::atomic<double>;
+
+    static void Increment(Counter& ioCounter, uint64_t inAmount = 1);
+    void RecordTime(uint32_t inFrames, double inSeconds, double inBudgetSeconds);
+
+    Counter mBlocks;
+    Counter mFrames;
+    Value mTotalSeconds;
+    Value mWorstSeconds;
+    Value mLastBudgetRatio;
+    Value mWorstBudgetRatio;
+    Counter mOverBudgetBlocks;
+    Counter mStarvedBlocks;
+    Counter mStarvedFrames;
+    std::atomic<uint32_t> mLastBufferedFrames;
+    std::atomic<uint32_t> mMinBufferedFrames;
+    Counter mRebuildRequests;
+    Counter mSlotSwaps;
+    Counter mSlotRestarts;
+    Counter mIdleBlocks;
+    Counter mWakeups;
+    Counter mMissedDeadlines;
+    Counter mBlockTimeHistogram[kNumberOfBins];
+    Counter mBudgetRatioHistogram[kNumberOfBins];
+    Counter mBufferedHistogram[kNumberOfBins];
+
+    std::atomic<bool> mClearRequested;
+};
+
+#endif /* __RenderStats_h__ */
@@ -0,0 +1,181 @@
+#include "RenderWorkerPool.h"
+#include <algorithm>
+#include <pthread.h>
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
+#else
+#include <sched.h>
+#endif
+
+namespace {
+
+// Share of a block the helpers may compute for, and how long past the
+// caller's own share Run() waits for them
+const double kComputationRatio = 0.5;
+const double kMaxWaitRatio = 0.5;
+
+// SCHED_FIFO priority: above normal threads, below the usual audio servers
+const int kRealtimePriority = 60;
+
+// Spins between clock reads while waiting for helpers
+const uint32_t kSpinsPerClockRead = 64;
+
+// Eases a spin-wait on the other hyperthread / core
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Ask for realtime scheduling for the calling thread; false when refused
+// (an unprivileged process on Linux, say), which leaves it as it was
+bool PromoteToRealtime(double inPeriodSeconds) {
+#if defined(__APPLE__)
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    const double ticksPerSecond = 1e9 * timebase.denom / timebase.numer;
+
+    thread_time_constraint_policy_data_t policy;
+    policy.period = static_cast<uint32_t>(inPeriodSeconds * ticksPerSecond);
+    policy.computation = static_cast<uint32_t>(inPeriodSeconds * kComputationRatio * ticksPerSecond);
+    policy.constraint = policy.period;
+    policy.preemptible = true;
+    return thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_TIME_CONSTRAINT_POLICY,
+                             reinterpret_cast<thread_policy_t>(&policy),
+                             THREAD_TIME_CONSTRAINT_POLICY_COUNT) == KERN_SUCCESS;
+#else
+    (void)inPeriodSeconds;
+    sched_param param = {};
+    param.sched_priority = std::clamp(kRealtimePriority, sched_get_priority_min(SCHED_FIFO),
+                                      sched_get_priority_max(SCHED_FIFO));
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#endif
+}
+
+} // namespace
+
+// Constructor
+RenderWorkerPool::RenderWorkerPool()
+    : mTask(nullptr),
+      mContext(nullptr),
+      mState(0),
+      mCompleted(0),
+      mCount(0),
+      mWake(0),
+      mRunning(false),
+      mPeriodSeconds(0.0),
+      mMaxWait(0)
+{
+}
+
+// Destructor
+RenderWorkerPool::~RenderWorkerPool() {
+    Stop();
+}
+
+void RenderWorkerPool::Start(uint32_t inNumThreads, double inPeriodSeconds) {
+    Stop();
+
+    mPeriodSeconds = inPeriodSeconds;
+    mMaxWait = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(inPeriodSeconds * kMaxWaitRatio));
+    mRunning.store(true);
+    mThreads.reserve(inNumThreads);
+    for (uint32_t i = 0; i < inNumThreads; ++i) {
+        mThreads.emplace_back(&RenderWorkerPool::ThreadLoop, this);
+    }
+}
+
+// Joining also waits out a task that missed its deadline
+void RenderWorkerPool::Stop() {
+    if (mThreads.empty()) {
+        return;
+    }
+
+    mRunning.store(false);
+    mWake.release(static_cast<std::ptrdiff_t>(mThreads.size()));
+    for (std::thread& thread : mThreads) {
+        thread.join();
+    }
+    mThreads.clear();
+    mCompleted.store(0, std::memory_order_relaxed);
+    mCount = 0;
+}
+
+void RenderWorkerPool::Wait() const {
+    while (IsBusy()) {
+        std::this_thread::yield();
+    }
+}
+
+bool RenderWorkerPool::RunOne() {
+    uint64_t state = mState.load(std::memory_order_acquire);
+    for (;;) {
+        const uint32_t count = static_cast<uint32_t>(state >> 32);
+        const uint32_t index = static_cast<uint32_t>(state);
+        if (index >= count) {
+            return false;
+        }
+        if (mState.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            // No new job is published before this task finishes, so its
+            // fields stay valid until mCompleted is bumped
+            mTask(mContext, index);
+            mCompleted.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+    }
+}
+
+bool RenderWorkerPool::Run(Task inTask, void* inContext, uint32_t inCount) {
+    if (IsBusy()) {
+        return false;
+    }
+    if (inCount == 0) {
+        return true;
+    }
+
+    // Publish the job, then wake as many helpers as could take a task
+    mTask = inTask;
+    mContext = inContext;
+    mCount = inCount;
+    mCompleted.store(0, std::memory_order_relaxed);
+    mState.store(static_cast<uint64_t>(inCount) << 32, std::memory_order_release);
+
+    const uint32_t helpers = std::min(GetNumThreads(), inCount - 1);
+    if (helpers > 0) {
+        mWake.release(helpers);
+    }
+
+    while (RunOne()) {
+    }
+
+    // Every index is claimed; wait a bounded time for the helpers' tasks
+    const auto deadline = std::chrono::steady_clock::now() + mMaxWait;
+    for (uint32_t spins = 1; IsBusy(); ++spins) {
+        if (spins % kSpinsPerClockRead == 0 && std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        CpuRelax();
+    }
+
+    // Close the job so a late helper finds nothing to claim
+    mState.store(0, std::memory_order_release);
+    return true;
+}
+
+void RenderWorkerPool::ThreadLoop() {
+    PromoteToRealtime(mPeriodSeconds);
+
+    for (;;) {
+        mWake.acquire();
+        if (!mRunning.load()) {
+            return;
+        }
+        while (RunOne()) {
+        }
+    }
+}
@@ -0,0 +1,73 @@
+// Standard library headers
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+// Include guards
+#ifndef __RenderWorkerPool_h__
+#define __RenderWorkerPool_h__
+
+// A few helper threads that split independent render work with the calling
+// thread. Run() hands out task indices through one atomic word and the
+// caller claims indices too, so a helper that is descheduled or asleep
+// before claiming a task never stalls the block. A helper that is
+// preempted in the middle of a task still can: helpers ask for realtime
+// scheduling (a time-constraint policy on macOS, SCHED_FIFO where the
+// process may use it), and the wait for their tasks is bounded all the
+// same.
+//
+// Start() and Stop() allocate and join; Run() never allocates or locks.
+// Run() is not reentrant: one calling thread at a time.
+class RenderWorkerPool
+{
+public:
+    typedef void (*Task)(void* inContext, uint32_t inIndex);
+
+    RenderWorkerPool();
+    ~RenderWorkerPool();
+
+    // inPeriodSeconds is the longest block: it sets the helpers' realtime
+    // constraint and how long Run() waits for them
+    void Start(uint32_t inNumThreads, double inPeriodSeconds);
+    void Stop();
+
+    // Runs inTask(inContext, i) for every i in [0, inCount) and returns true
+    // once all have finished. Returns false when a helper's task misses the
+    // deadline, leaving it running, or when one from an earlier call still
+    // is (then nothing runs). Until IsBusy() clears, the caller must leave
+    // alone everything the tasks touch.
+    bool Run(Task inTask, void* inContext, uint32_t inCount);
+
+    // Calling thread: a task that missed its deadline is still running
+    bool IsBusy() const { return mCompleted.load(std::memory_order_acquire) < mCount; }
+
+    // Blocks until IsBusy() clears. Not for the render thread.
+    void Wait() const;
+
+    uint32_t GetNumThreads() const { return static_cast<uint32_t>(mThreads.size()); }
+
+private:
+    void ThreadLoop();
+
+    // Claims and runs one task of the current job; false when none is left
+    bool RunOne();
+
+    // The current job. mState packs the task count (high half) and the next
+    // unclaimed index (low half), so a claim is a single compare-exchange.
+    Task mTask;
+    void* mContext;
+    std::atomic<uint64_t> mState;
+    std::atomic<uint32_t> mCompleted;
+    uint32_t mCount;
+
+    std::vector<std::thread> mThreads;
+    std::counting_semaphore<> mWake;
+    std::atomic<bool> mRunning;
+    double mPeriodSeconds;
+    std::chrono::steady_clock::duration mMaxWait;
+};
+
+#endif /* __RenderWorkerPool_h__ */
@@ -0,0 +1,38 @@
+// Standard library headers
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Include guards
+#ifndef __SharedCache_h__
+#define __SharedCache_h__
+
+// Process-wide cache of read-only tables (FFT twiddles, windows) keyed by
+// whatever determines their contents. Every instance asking for the same
+// key gets the same table; it is freed when the last one lets go. Get() may
+// run on any thread but locks and may build, so it belongs in Prepare()
+// rather than on the render thread.
+template <typename Key, typename Value>
+class SharedCache
+{
+public:
+    // The table for inKey, built with inBuild() (returning a Value) if no
+    // instance holds one
+    template <typename Build>
+    std::shared_ptr<const Value> Get(const Key& inKey, Build&& inBuild) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::weak_ptr<const Value>& entry = mEntries[inKey];
+        std::shared_ptr<const Value> value = entry.lock();
+        if (!value) {
+            value = std::make_shared<const Value>(inBuild());
+            entry = value;
+        }
+        return value;
+    }
+
+private:
+    std::mutex mMutex;
+    std::map<Key, std::weak_ptr<const Value>> mEntries;
+};
+
+#endif /* __SharedCache_h__ */
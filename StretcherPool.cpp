@@ -0,0 +1,133 @@
+#include "StretcherPool.h"
+#include <algorithm>
+
+namespace {
+
+// Parked slots beyond this many, or parked longer than this, are freed.
+// Enough to carry a large session through a host's re-initialization.
+const size_t kMaxParkedSlots = 32;
+const auto kMaxParkedTime = std::chrono::seconds(10);
+
+// Measured delays kept; far more configurations than a session switches
+// between
+const size_t kMaxMeasuredDelays = 64;
+
+} // namespace
+
+StretcherPool& StretcherPool::GetInstance() {
+    static StretcherPool sPool;
+    return sPool;
+}
+
+StretcherPool::~StretcherPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mExpiryWake.notify_one();
+    if (mExpiryThread.joinable()) {
+        mExpiryThread.join();
+    }
+}
+
+std::unique_ptr<StretcherSlot> StretcherPool::Acquire(double inSampleRate, uint32_t inNumInputChannels,
+                                                      uint32_t inMaxFramesPerBlock,
+                                                      const StretcherSettings& inSettings) {
+    std::vector<std::unique_ptr<StretcherSlot>> expired;
+    std::unique_ptr<StretcherSlot> slot;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Expire(expired);
+
+        // Most recently parked first: its memory is the likeliest to be warm
+        for (size_t i = mParked.size(); i-- > 0; ) {
+            const StretcherSlot& parked = *mParked[i].slot;
+            if (parked.GetSampleRate() == inSampleRate && parked.GetNumInputChannels() == inNumInputChannels &&
+                parked.GetMaxFramesPerBlock() >= inMaxFramesPerBlock && parked.GetSettings() == inSettings) {
+                slot = std::move(mParked[i].slot);
+                mParked.erase(mParked.begin() + static_cast<ptrdiff_t>(i));
+                break;
+            }
+        }
+    }
+
+    if (slot) {
+        slot->Reset(0);
+    } else {
+        slot = std::make_unique<StretcherSlot>(inSampleRate, inNumInputChannels, inMaxFramesPerBlock, inSettings);
+    }
+    return slot;
+}
+
+void StretcherPool::Release(std::unique_ptr<StretcherSlot> inSlot) {
+    std::vector<std::unique_ptr<StretcherSlot>> expired;
+    if (inSlot) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mParked.push_back({ std::move(inSlot), Clock::now() });
+        Expire(expired);
+        if (!mExpiryThread.joinable()) {
+            mExpiryThread = std::thread(&StretcherPool::ExpiryLoop, this);
+        }
+    }
+    mExpiryWake.notify_one();
+}
+
+uint32_t StretcherPool::GetDelayFrames(double inSampleRate, uint32_t inNumInputChannels, uint32_t inMaxFramesPerBlock,
+                                       const StretcherSettings& inSettings) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const MeasuredDelay& delay : mDelays) {
+            if (delay.sampleRate == inSampleRate && delay.numInputChannels == inNumInputChannels &&
+                delay.maxFramesPerBlock == inMaxFramesPerBlock && delay.settings == inSettings) {
+                return delay.delayFrames;
+            }
+        }
+    }
+
+    // Built outside the lock; two threads measuring the same configuration
+    // at once both get the same answer
+    const uint32_t delayFrames =
+        StretcherSlot(inSampleRate, inNumInputChannels, inMaxFramesPerBlock, inSettings).GetDelayFrames();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mDelays.size() >= kMaxMeasuredDelays) {
+        mDelays.erase(mDelays.begin());
+    }
+    mDelays.push_back({ inSampleRate, inNumInputChannels, inMaxFramesPerBlock, inSettings, delayFrames });
+    return delayFrames;
+}
+
+void StretcherPool::Clear() {
+    std::vector<ParkedSlot> parked;
+    std::lock_guard<std::mutex> lock(mMutex);
+    parked.swap(mParked);
+}
+
+void StretcherPool::Expire(std::vector<std::unique_ptr<StretcherSlot>>& outExpired) {
+    const Clock::time_point oldest = Clock::now() - kMaxParkedTime;
+    size_t count = 0;
+    while (count < mParked.size() &&
+           (mParked.size() - count > kMaxParkedSlots || mParked[count].since < oldest)) {
+        outExpired.push_back(std::move(mParked[count].slot));
+        ++count;
+    }
+    mParked.erase(mParked.begin(), mParked.begin() + static_cast<ptrdiff_t>(count));
+}
+
+void StretcherPool::ExpiryLoop() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mStopping) {
+        if (mParked.empty()) {
+            mExpiryWake.wait(lock);
+            continue;
+        }
+        mExpiryWake.wait_until(lock, mParked.front().since + kMaxParkedTime);
+
+        // Freed outside the lock
+        std::vector<std::unique_ptr<StretcherSlot>> expired;
+        Expire(expired);
+        lock.unlock();
+        expired.clear();
+        lock.lock();
+    }
+}
@@ -0,0 +1,90 @@
+// Standard library headers
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "StretcherSlot.h"
+
+// Include guards
+#ifndef __StretcherPool_h__
+#define __StretcherPool_h__
+
+// Process-wide pool of built stretcher slots. Building one (a RubberBand
+// instance with its FFT setup and buffers) is the slow part of Prepare(),
+// and hosts tear every instance down and build it again on any format
+// change, so slots an engine lets go of are parked here for a few seconds.
+// The next engine asking for the same rate, channels and settings, or the
+// same one after its Initialize(), takes one back instead of constructing
+// it, as does the hot-swap worker when a setting is switched back.
+//
+// The pool also remembers the delay of the configurations it was last asked
+// about, so only the first engine in the process builds slots just to
+// measure them.
+//
+// Thread-safe. Every call takes a lock and may build or free a slot, so
+// none of them belong on the render thread. A thread of the pool's own,
+// started with the first Release(), frees slots as they expire, whether or
+// not any engine is still around to call in.
+class StretcherPool
+{
+public:
+    static StretcherPool& GetInstance();
+
+    // A slot reset to timeline index 0: a parked one built for the same rate,
+    // channels and settings and at least inMaxFramesPerBlock, or a new one
+    std::unique_ptr<StretcherSlot> Acquire(double inSampleRate, uint32_t inNumInputChannels,
+                                           uint32_t inMaxFramesPerBlock, const StretcherSettings& inSettings);
+
+    // Parks a slot for reuse. Slots parked longest are freed once the pool
+    // is full, and every slot once it has waited too long.
+    void Release(std::unique_ptr<StretcherSlot> inSlot);
+
+    // StretcherSlot::GetDelayFrames() for a slot built with these arguments
+    uint32_t GetDelayFrames(double inSampleRate, uint32_t inNumInputChannels, uint32_t inMaxFramesPerBlock,
+                            const StretcherSettings& inSettings);
+
+    // Frees every parked slot
+    void Clear();
+
+private:
+    StretcherPool() = default;
+    ~StretcherPool();
+
+    using Clock = std::chrono::steady_clock;
+
+    struct ParkedSlot
+    {
+        std::unique_ptr<StretcherSlot> slot;
+        Clock::time_point since;
+    };
+
+    struct MeasuredDelay
+    {
+        double sampleRate;
+        uint32_t numInputChannels;
+        uint32_t maxFramesPerBlock;
+        StretcherSettings settings;
+        uint32_t delayFrames;
+    };
+
+    // Moves slots parked too long, or beyond the pool size, to outExpired
+    // so they are freed outside the lock
+    void Expire(std::vector<std::unique_ptr<StretcherSlot>>& outExpired);
+
+    // Sleeps until the oldest parked slot is due, then frees it
+    void ExpiryLoop();
+
+    std::mutex mMutex;
+    std::vector<ParkedSlot> mParked;      // Oldest first
+    std::vector<MeasuredDelay> mDelays;   // Oldest first
+
+    std::thread mExpiryThread;
+    std::condition_variable mExpiryWake;
+    bool mStopping = false;
+};
+
+#endif /* __StretcherPool_h__ */
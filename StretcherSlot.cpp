@@ -0,0 +1,526 @@
+#include "StretcherSlot.h"
+#include "PitchShifterParameters.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Upper bound on what RubberBand asks for or emits in one go (hop plus
+// startup requirement); the FIFOs get this much headroom on top of the
+// host block and the stretcher latency
+const uint32_t kMaxStretcherChunk = 4096;
+
+// Extra delay on top of the stretcher's start delay, so an output burst
+// arriving a hop late never starves the host (nominal RubberBand hop at
+// 48 kHz)
+const uint32_t kOutputCushionFrames = 512;
+const uint32_t kShortOutputCushionFrames = 256;
+
+// The low band is decimated by a power of two down to at least this rate,
+// and brought back with a lowpass that passes lows shifted up two octaves
+const double kMinDecimatedRate = 11000.0;
+const double kUpsamplerFrequency = 1500.0;
+
+// Harmonizer FFT size per latency tier at 48 kHz, doubled for every
+// doubling of the rate so the frequency resolution holds
+const uint32_t kHarmonyFftSizes[kNumberOfLatencyModes] = { 4096, 2048, 1024 };
+
+static_assert(Harmonizer::kMaxVoices == kNumberOfHarmonyVoices, "one harmonizer voice per voice parameter set");
+
+int64_t CeilDiv(int64_t inNumerator, int64_t inDenominator) {
+    int64_t quotient = inNumerator / inDenominator;
+    if (quotient * inDenominator < inNumerator) {
+        ++quotient;
+    }
+    return quotient;
+}
+
+uint32_t GetHarmonyFftSize(double inSampleRate, int inLatencyMode) {
+    uint32_t size = kHarmonyFftSizes[inLatencyMode];
+    for (double rate = inSampleRate; rate >= 1.5 * 48000.0; rate /= 2.0) {
+        size *= 2;
+    }
+    return size;
+}
+
+} // namespace
+
+// Constructor
+StretcherSlot::StretcherSlot(double inSampleRate, uint32_t inNumInputChannels, uint32_t inMaxFramesPerBlock,
+                             const StretcherSettings& inSettings)
+    : mSettings(inSettings),
+      mKernels(GetAudioKernels()),
+      mSampleRate(inSampleRate),
+      mNumInputChannels(inNumInputChannels),
+      mNumStretchChannels((inSettings.stereoMode == kStereoMode_Mono) ? 1 : inNumInputChannels),
+      mNumWetChannels((inSettings.harmonyChannels > 0) ? inSettings.harmonyChannels : mNumStretchChannels),
+      mMaxFramesPerBlock(inMaxFramesPerBlock),
+      mStretchChunkFrames(std::max(inMaxFramesPerBlock, kMaxStretcherChunk)),
+      mDelayFrames(0),
+      mPitchScale(1.0),
+      mDecimation(1),
+      mUpsampleDelayFrames(0),
+      mUpsampleIndex(0),
+      mBandFrames(0),
+      mDecimatedFrames(0),
+      mNextInputIndex(0),
+      mOutputIndex(0),
+      mStartDelayToDrop(0),
+      mNextRetired(nullptr)
+{
+    if (inSettings.bandSplit) {
+        while (inSampleRate / (2 * mDecimation) >= kMinDecimatedRate) {
+            mDecimation *= 2;
+        }
+        const double decimatedRate = inSampleRate / mDecimation;
+        const uint32_t maxDecimatedFrames = inMaxFramesPerBlock / mDecimation + 1;
+
+        // Children stretch the already folded channels; the window choice
+        // replaces the parent's
+        StretcherSettings bandSettings = inSettings;
+        bandSettings.stereoMode = kStereoMode_Independent;
+        bandSettings.bandSplit = false;
+        bandSettings.minDelayFrames = 0;
+        bandSettings.options &= ~(RubberBand::RubberBandStretcher::OptionWindowShort |
+                                  RubberBand::RubberBandStretcher::OptionWindowLong);
+
+        StretcherSettings lowSettings = bandSettings;
+        if (inSettings.latencyMode == kLatencyMode_HighQuality) {
+            lowSettings.options |= RubberBand::RubberBandStretcher::OptionWindowLong;
+        }
+        StretcherSettings highSettings = bandSettings;
+        highSettings.options |= RubberBand::RubberBandStretcher::OptionWindowShort;
+        highSettings.latencyMode = kLatencyMode_Short;
+
+        mLowBand = std::make_unique<StretcherSlot>(decimatedRate, mNumStretchChannels, maxDecimatedFrames, lowSettings);
+        mHighBand = std::make_unique<StretcherSlot>(inSampleRate, mNumStretchChannels, inMaxFramesPerBlock, highSettings);
+
+        mCrossover.Prepare(inSampleRate, mNumStretchChannels);
+        mUpsampler.Prepare(inSampleRate, mNumStretchChannels, std::min(kUpsamplerFrequency, 0.4 * decimatedRate));
+        mUpsampleDelayFrames = static_cast<uint32_t>(lround(mUpsampler.GetGroupDelayFrames()));
+
+        // Matched delay: the lows need their stretcher delay at the full
+        // rate plus the upsampler and one decimation step; the highs are
+        // read just as late
+        const uint32_t lowDelay = mLowBand->GetDelayFrames() * mDecimation + mUpsampleDelayFrames + mDecimation;
+        mDelayFrames = std::max({ lowDelay, mHighBand->GetDelayFrames(), inSettings.minDelayFrames });
+        mHighBand->ExtendDelay(mDelayFrames);
+        mLowBand->ExtendDelay(static_cast<uint32_t>(CeilDiv(mDelayFrames - mUpsampleDelayFrames, mDecimation)) + 1);
+
+        mBandBuffer.assign(static_cast<size_t>(2 * mNumStretchChannels) * inMaxFramesPerBlock, 0.0f);
+        mDecimatedBuffer.assign(static_cast<size_t>(mNumStretchChannels) * maxDecimatedFrames, 0.0f);
+        mLowPtrs.resize(mNumStretchChannels);
+        mHighPtrs.resize(mNumStretchChannels);
+        mDecimatedPtrs.resize(mNumStretchChannels);
+        for (uint32_t channel = 0; channel < mNumStretchChannels; ++channel) {
+            mLowPtrs[channel] = mBandBuffer.data() + static_cast<size_t>(channel) * inMaxFramesPerBlock;
+            mHighPtrs[channel] = mBandBuffer.data() + static_cast<size_t>(mNumStretchChannels + channel) * inMaxFramesPerBlock;
+            mDecimatedPtrs[channel] = mDecimatedBuffer.data() + static_cast<size_t>(channel) * maxDecimatedFrames;
+        }
+    } else if (inSettings.harmonyChannels > 0) {
+        // Sample-synchronous as well, one window behind
+        mHarmonizer.Prepare(inSampleRate, mNumStretchChannels, mNumWetChannels,
+                            GetHarmonyFftSize(inSampleRate, inSettings.latencyMode));
+        mDelayFrames = mHarmonizer.GetLatencyFrames();
+    } else if (inSettings.monophonic) {
+        // Sample-synchronous too
+        mPsola.Prepare(inSampleRate, mNumStretchChannels);
+        mDelayFrames = mPsola.GetLatencyFrames();
+    } else if (inSettings.latencyMode == kLatencyMode_Live) {
+        // Sample-synchronous: output is ready as soon as input arrives, so no
+        // cushion and no input FIFO
+        mGranular.Prepare(inSampleRate, mNumStretchChannels);
+        mDelayFrames = mGranular.GetLatencyFrames();
+    } else {
+        mStretcher = std::make_unique<RubberBand::RubberBandStretcher>(
+            static_cast<size_t>(inSampleRate),
+            mNumStretchChannels,
+            inSettings.options
+        );
+        mStretcher->setMaxProcessSize(mStretchChunkFrames);
+
+        // The short window also emits output in shorter bursts
+        const uint32_t cushionFrames = (inSettings.latencyMode == kLatencyMode_Short) ?
+            kShortOutputCushionFrames : kOutputCushionFrames;
+        const uint32_t startDelay = static_cast<uint32_t>(mStretcher->getStartDelay());
+        mDelayFrames = startDelay + static_cast<uint32_t>(cushionFrames * std::max(1.0, inSampleRate / 48000.0));
+    }
+    mDelayFrames = std::max(mDelayFrames, inSettings.minDelayFrames);
+
+    AllocateFifos();
+
+    const uint32_t numBufferChannels = std::max(mNumStretchChannels, mNumWetChannels);
+    mStretchBuffer.assign(static_cast<size_t>(numBufferChannels) * mStretchChunkFrames, 0.0f);
+    mFoldBuffer.assign(inMaxFramesPerBlock, 0.0f);
+    mStretchPtrs.resize(numBufferChannels);
+    mReadPtrs.resize(mNumWetChannels);
+    mChunkPtrs.resize(inNumInputChannels);
+    for (uint32_t channel = 0; channel < numBufferChannels; ++channel) {
+        mStretchPtrs[channel] = mStretchBuffer.data() + static_cast<size_t>(channel) * mStretchChunkFrames;
+    }
+
+    Reset(0);
+}
+
+// Destructor
+StretcherSlot::~StretcherSlot() {
+}
+
+// Size the FIFOs from the host block and the latency. A split slot keeps
+// its audio in the children.
+void StretcherSlot::AllocateFifos() {
+    if (mLowBand) {
+        return;
+    }
+    const uint32_t fifoFrames = 2 * (mMaxFramesPerBlock + mDelayFrames) + mStretchChunkFrames;
+    if (mStretcher) {
+        mInputFifo.Allocate(mNumStretchChannels, fifoFrames);
+    }
+    mOutputFifo.Allocate(mNumWetChannels, fifoFrames);
+}
+
+void StretcherSlot::ExtendDelay(uint32_t inDelayFrames) {
+    if (inDelayFrames > mDelayFrames) {
+        mDelayFrames = inDelayFrames;
+        AllocateFifos();
+    }
+}
+
+void StretcherSlot::Reset(int64_t inStartIndex) {
+    if (mLowBand) {
+        mCrossover.Reset();
+        mUpsampler.Reset();
+        mHighBand->Reset(inStartIndex);
+        mLowBand->Reset(CeilDiv(inStartIndex, mDecimation));
+        mUpsampleIndex = inStartIndex - mDelayFrames + mUpsampleDelayFrames;
+    } else if (mStretcher) {
+        // Padded below, once the FIFOs are empty
+        mStretcher->reset();
+        mStretcher->setPitchScale(mPitchScale);
+        mStartDelayToDrop = static_cast<uint32_t>(mStretcher->getStartDelay());
+    } else if (mSettings.harmonyChannels > 0) {
+        mHarmonizer.SetPitchScale(mPitchScale);
+        mHarmonizer.Reset();
+        mStartDelayToDrop = mHarmonizer.GetLatencyFrames();
+    } else if (mSettings.monophonic) {
+        mPsola.SetPitchScale(mPitchScale);
+        mPsola.Reset();
+        mStartDelayToDrop = mPsola.GetLatencyFrames();
+    } else {
+        mGranular.SetPitchScale(mPitchScale);
+        mGranular.Reset();
+        mStartDelayToDrop = mGranular.GetLatencyFrames();
+    }
+    mInputFifo.Clear();
+    mOutputFifo.Clear();
+    mNextInputIndex = inStartIndex;
+    mOutputIndex = inStartIndex;
+
+    // RubberBand in real-time mode neither pads nor compensates its start:
+    // lead it in with the silence it asks for, off the timeline, so that
+    // dropping the start delay leaves frame n of the output aligned with
+    // input frame n from the very first one
+    if (mStretcher) {
+        uint32_t padFrames = static_cast<uint32_t>(mStretcher->getPreferredStartPad());
+        while (padFrames > 0) {
+            const uint32_t frames = mInputFifo.WriteSilence(padFrames);
+            padFrames -= frames;
+            if (padFrames > 0) {
+                PumpStretcher();
+            }
+        }
+    }
+}
+
+void StretcherSlot::SetPitchScale(double inPitchScale) {
+    if (inPitchScale != mPitchScale) {
+        mPitchScale = inPitchScale;
+        if (mLowBand) {
+            mLowBand->SetPitchScale(inPitchScale);
+            mHighBand->SetPitchScale(inPitchScale);
+        } else if (mStretcher) {
+            mStretcher->setPitchScale(inPitchScale);
+        } else if (mSettings.harmonyChannels > 0) {
+            mHarmonizer.SetPitchScale(inPitchScale);
+        } else if (mSettings.monophonic) {
+            mPsola.SetPitchScale(inPitchScale);
+        } else {
+            mGranular.SetPitchScale(inPitchScale);
+        }
+    }
+}
+
+void StretcherSlot::SetCrossoverFrequency(double inFrequency) {
+    if (mLowBand) {
+        mCrossover.SetFrequency(inFrequency);
+    }
+}
+
+void StretcherSlot::SetVoices(const HarmonyVoice* inVoices, uint32_t inNumVoices) {
+    if (mSettings.harmonyChannels > 0) {
+        mHarmonizer.SetVoices(inVoices, inNumVoices);
+    }
+}
+
+void StretcherSlot::SetPitchEstimate(double inPeriodFrames, float inAperiodicity) {
+    if (mSettings.monophonic) {
+        mPsola.SetPitchEstimate(inPeriodFrames, inAperiodicity);
+    }
+}
+
+// Queue input, folding to mono if this slot stretches fewer channels
+bool StretcherSlot::Write(const float* const* inInputs, uint32_t inFrames, RenderWorkerPool* inPool) {
+    for (uint32_t done = 0; done < inFrames; ) {
+        const uint32_t frames = std::min(inFrames - done, mMaxFramesPerBlock);
+
+        // Nobody reads while the slot is pre-rolled or caught up; drop
+        // output that no Read() can ask for any more so the FIFOs keep moving
+        const int64_t oldestWanted = mNextInputIndex + done - mDelayFrames - mMaxFramesPerBlock;
+        if (mOutputIndex < oldestWanted) {
+            mOutputIndex += mOutputFifo.Discard(static_cast<uint32_t>(std::min<int64_t>(oldestWanted - mOutputIndex, UINT32_MAX)));
+        }
+
+        for (uint32_t channel = 0; channel < mNumInputChannels; ++channel) {
+            mChunkPtrs[channel] = inInputs[channel] + done;
+        }
+
+        const float* const* chunk = mChunkPtrs.data();
+        const float* foldData = mFoldBuffer.data();
+        if (mNumStretchChannels < mNumInputChannels) {
+            const float scale = 1.0f / mNumInputChannels;
+            for (uint32_t frame = 0; frame < frames; ++frame) {
+                float sum = 0.0f;
+                for (uint32_t channel = 0; channel < mNumInputChannels; ++channel) {
+                    sum += mChunkPtrs[channel][frame];
+                }
+                mFoldBuffer[frame] = sum * scale;
+            }
+            chunk = &foldData;
+        }
+
+        if (mLowBand) {
+            if (!WriteBands(chunk, mNextInputIndex + done, frames, inPool)) {
+                return false;
+            }
+        } else if (mStretcher) {
+            mInputFifo.Write(chunk, frames);
+            PumpStretcher();
+        } else if (mSettings.harmonyChannels > 0) {
+            if (!mHarmonizer.Process(chunk, mStretchPtrs.data(), frames, inPool)) {
+                return false;
+            }
+            WriteOutput(mStretchPtrs.data(), frames);
+        } else if (mSettings.monophonic) {
+            mPsola.Process(chunk, mStretchPtrs.data(), frames);
+            WriteOutput(mStretchPtrs.data(), frames);
+        } else {
+            mGranular.Process(chunk, mStretchPtrs.data(), frames);
+            WriteOutput(mStretchPtrs.data(), frames);
+        }
+        done += frames;
+    }
+
+    // The pitch estimate covered this write only
+    if (mSettings.monophonic) {
+        mPsola.ClearPitchEstimate();
+    }
+    mNextInputIndex += inFrames;
+    return true;
+}
+
+// Feed buffered input to the stretcher and collect its output
+void StretcherSlot::PumpStretcher() {
+    for (;;) {
+        // Drain everything the stretcher has ready that the output FIFO can
+        // take
+        int available = mStretcher->available();
+        while (available > 0) {
+            const uint32_t frames = std::min({ static_cast<uint32_t>(available),
+                                               mOutputFifo.GetWriteAvailable(),
+                                               mStretchChunkFrames });
+            if (frames == 0) {
+                break;
+            }
+            mStretcher->retrieve(mStretchPtrs.data(), frames);
+            available -= static_cast<int>(frames);
+            WriteOutput(mStretchPtrs.data(), frames);
+        }
+
+        // Only call process() once a full hop is buffered, so tiny host
+        // blocks don't turn into many tiny stretcher calls
+        const uint32_t buffered = mInputFifo.GetReadAvailable();
+        const uint32_t required = std::clamp<uint32_t>(
+            static_cast<uint32_t>(mStretcher->getSamplesRequired()), 1, mStretchChunkFrames);
+        if (buffered < required || mOutputFifo.GetWriteAvailable() == 0) {
+            return;
+        }
+
+        const uint32_t frames = mInputFifo.Read(mStretchPtrs.data(), std::min(buffered, mStretchChunkFrames));
+        mStretcher->process(mStretchPtrs.data(), frames, false);
+    }
+}
+
+// Discard the start delay so FIFO frames line up with input frames
+void StretcherSlot::WriteOutput(float* const* inData, uint32_t inFrames) {
+    const uint32_t dropped = std::min(inFrames, mStartDelayToDrop);
+    mStartDelayToDrop -= dropped;
+    for (uint32_t channel = 0; channel < mNumWetChannels; ++channel) {
+        mReadPtrs[channel] = inData[channel] + dropped;
+    }
+    mOutputFifo.Write(mReadPtrs.data(), inFrames - dropped);
+}
+
+// Split one chunk, decimate the lows (the crossover is their anti-alias
+// filter) and stretch both bands
+bool StretcherSlot::WriteBands(const float* const* inChunk, int64_t inFirstIndex, uint32_t inFrames,
+                               RenderWorkerPool* inPool) {
+    mCrossover.Process(inChunk, mLowPtrs.data(), mHighPtrs.data(), inFrames);
+
+    // Low band timeline index j is full-rate index j * mDecimation
+    uint32_t frame = static_cast<uint32_t>(CeilDiv(inFirstIndex, mDecimation) * mDecimation - inFirstIndex);
+    uint32_t decimated = 0;
+    for (; frame < inFrames; frame += mDecimation, ++decimated) {
+        for (uint32_t channel = 0; channel < mNumStretchChannels; ++channel) {
+            mDecimatedPtrs[channel][decimated] = mLowPtrs[channel][frame];
+        }
+    }
+    mBandFrames = inFrames;
+    mDecimatedFrames = decimated;
+
+    if (inPool) {
+        return inPool->Run(&StretcherSlot::WriteBandTask, this, 2);
+    }
+    WriteBand(0);
+    WriteBand(1);
+    return true;
+}
+
+void StretcherSlot::WriteBand(uint32_t inBand) {
+    if (inBand == 0) {
+        mHighBand->Write(mHighPtrs.data(), mBandFrames);
+    } else {
+        mLowBand->Write(mDecimatedPtrs.data(), mDecimatedFrames);
+    }
+}
+
+void StretcherSlot::WriteBandTask(void* inContext, uint32_t inBand) {
+    static_cast<StretcherSlot*>(inContext)->WriteBand(inBand);
+}
+
+// Sum the highs with the lows brought back to the full rate. The lows are
+// read mUpsampleDelayFrames ahead so they come out of the upsampler aligned.
+uint32_t StretcherSlot::ReadBands(float* const* outWet, int64_t inFirstIndex, uint32_t inFrames) {
+    const uint32_t highStarved = mHighBand->Read(outWet, inFirstIndex, inFrames);
+
+    const int64_t start = inFirstIndex + mUpsampleDelayFrames;
+    if (start != mUpsampleIndex) {
+        mUpsampler.Reset();
+    }
+    mUpsampleIndex = start + inFrames;
+
+    const int64_t firstDecimated = CeilDiv(start, mDecimation);
+    const uint32_t numDecimated = static_cast<uint32_t>(CeilDiv(start + inFrames, mDecimation) - firstDecimated);
+    const uint32_t lowStarved = mLowBand->Read(mDecimatedPtrs.data(), firstDecimated, numDecimated);
+
+    // Zero-stuff, with the gain the dropped samples took
+    const uint32_t offset = static_cast<uint32_t>(firstDecimated * mDecimation - start);
+    const float gain = static_cast<float>(mDecimation);
+    for (uint32_t channel = 0; channel < mNumStretchChannels; ++channel) {
+        float* low = mLowPtrs[channel];
+        std::fill_n(low, inFrames, 0.0f);
+        for (uint32_t i = 0; i < numDecimated; ++i) {
+            low[offset + i * mDecimation] = gain * mDecimatedPtrs[channel][i];
+        }
+    }
+    mUpsampler.Process(mLowPtrs.data(), inFrames);
+
+    for (uint32_t channel = 0; channel < mNumStretchChannels; ++channel) {
+        mKernels.Accumulate(mLowPtrs[channel], outWet[channel], 1.0f, inFrames);
+    }
+    return std::max(highStarved, std::min(lowStarved * mDecimation, inFrames));
+}
+
+// Read wet frames by timeline index
+uint32_t StretcherSlot::Read(float* const* outWet, int64_t inFirstIndex, uint32_t inFrames) {
+    if (mLowBand) {
+        return ReadBands(outWet, inFirstIndex, inFrames);
+    }
+
+    // Skip output older than requested (only after a timeline jump)
+    if (mOutputIndex < inFirstIndex) {
+        const uint32_t stale = static_cast<uint32_t>(std::min<int64_t>(inFirstIndex - mOutputIndex,
+                                                                       mOutputFifo.GetReadAvailable()));
+        mOutputFifo.Discard(stale);
+        mOutputIndex += stale;
+    }
+
+    // Frames before the FIFO front have not been produced: silence
+    const uint32_t leading = static_cast<uint32_t>(std::clamp<int64_t>(mOutputIndex - inFirstIndex, 0, inFrames));
+    const uint32_t readable = std::min(inFrames - leading, mOutputFifo.GetReadAvailable());
+    for (uint32_t channel = 0; channel < mNumWetChannels; ++channel) {
+        std::fill_n(outWet[channel], leading, 0.0f);
+        mReadPtrs[channel] = outWet[channel] + leading;
+    }
+    mOutputFifo.Read(mReadPtrs.data(), readable);
+    mOutputIndex += readable;
+
+    // Stretcher stalled: pad the gap so the block is complete. The late
+    // frames are skipped as stale once they arrive, keeping alignment.
+    const uint32_t trailing = inFrames - leading - readable;
+    for (uint32_t channel = 0; channel < mNumWetChannels; ++channel) {
+        std::fill_n(outWet[channel] + leading + readable, trailing, 0.0f);
+    }
+    return trailing;
+}
+
+uint32_t StretcherSlot::GetBufferedFrames() const {
+    if (mLowBand) {
+        return std::min(mHighBand->GetBufferedFrames(), mLowBand->GetBufferedFrames() * mDecimation);
+    }
+    return mOutputFifo.GetReadAvailable();
+}
+
+StretcherSettings GetStretcherSettings(const float* inValues, uint32_t inNumInputChannels, uint32_t inNumOutputChannels,
+                                       int inLatencyMode, bool inBandSplit, bool inHarmony, bool inMonophonic) {
+    StretcherSettings settings;
+    settings.stereoMode = static_cast<int>(inValues[kParam_StereoMode]);
+    settings.latencyMode = inLatencyMode;
+
+    // The harmonizer has no options either, analyses channels independently
+    // and ignores the band split; its voices are panned over up to two
+    // outputs
+    if (inHarmony) {
+        if (settings.stereoMode == kStereoMode_MidSide) {
+            settings.stereoMode = kStereoMode_Independent;
+        }
+        settings.harmonyChannels = std::min<uint32_t>(2, inNumOutputChannels);
+        return settings;
+    }
+
+    // The granular and PSOLA shifters have no options and always treat
+    // channels independently, so only a change that matters rebuilds them
+    settings.monophonic = inMonophonic && !inBandSplit && settings.latencyMode != kLatencyMode_Live;
+    if (settings.latencyMode == kLatencyMode_Live || settings.monophonic) {
+        if (settings.stereoMode == kStereoMode_MidSide) {
+            settings.stereoMode = kStereoMode_Independent;
+        }
+        return settings;
+    }
+
+    // Transients stay at OptionTransientsCrisp (the zero default)
+    settings.options =
+        RubberBand::RubberBandStretcher::OptionProcessRealTime |
+        RubberBand::RubberBandStretcher::OptionPitchHighQuality;
+    if (inValues[kParam_Formant] > 50.0f) {
+        settings.options |= RubberBand::RubberBandStretcher::OptionFormantPreserved;
+    }
+    if (settings.latencyMode == kLatencyMode_Short) {
+        settings.options |= RubberBand::RubberBandStretcher::OptionWindowShort;
+    }
+    if (settings.stereoMode == kStereoMode_MidSide && inNumInputChannels == 2) {
+        settings.options |= RubberBand::RubberBandStretcher::OptionChannelsTogether;
+    }
+    settings.bandSplit = inBandSplit;
+    return settings;
+}
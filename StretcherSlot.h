@@ -0,0 +1,197 @@
+// Standard library headers
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Third-party library headers
+#include <rubberband/RubberBandStretcher.h>
+
+#include "AudioFifo.h"
+#include "AudioKernels.h"
+#include "Crossover.h"
+#include "GranularShifter.h"
+#include "Harmonizer.h"
+#include "PsolaShifter.h"
+#include "RenderWorkerPool.h"
+
+// Include guards
+#ifndef __StretcherSlot_h__
+#define __StretcherSlot_h__
+
+// Everything fixed when a slot is constructed. A change to any of it means
+// building a new one.
+struct StretcherSettings
+{
+    RubberBand::RubberBandStretcher::Options options = 0;  // Unused in kLatencyMode_Live
+    int stereoMode = 0;
+    int latencyMode = 0;
+    bool bandSplit = false;   // Two-band crossover; RubberBand tiers only
+    uint32_t harmonyChannels = 0;  // Harmonizer output channels, 0 when off
+    bool monophonic = false;  // PsolaShifter instead of RubberBand
+    uint32_t minDelayFrames = 0;  // Read at least this late, to line up with another engine
+
+    bool operator==(const StretcherSettings& inOther) const {
+        return options == inOther.options && stereoMode == inOther.stereoMode &&
+               latencyMode == inOther.latencyMode && bandSplit == inOther.bandSplit &&
+               harmonyChannels == inOther.harmonyChannels && monophonic == inOther.monophonic &&
+               minDelayFrames == inOther.minDelayFrames;
+    }
+    bool operator!=(const StretcherSettings& inOther) const { return !(*this == inOther); }
+};
+
+// Maps parameter values (indexed by parameter ID) to construction settings
+// for a real-time slot, in the given latency tier and with or without band
+// split and harmonizer. Shared by the engine and the offline tools so both
+// read the parameters the same way. inMonophonic picks the PSOLA shifter
+// for a RubberBand tier without band split or harmonizer.
+StretcherSettings GetStretcherSettings(const float* inValues, uint32_t inNumInputChannels, uint32_t inNumOutputChannels,
+                                       int inLatencyMode, bool inBandSplit, bool inHarmony, bool inMonophonic = false);
+
+// One RubberBand instance with its input/output FIFOs and scratch buffers,
+// or in kLatencyMode_Live a GranularShifter feeding the output FIFO directly,
+// or with monophonic a PsolaShifter doing the same.
+// With harmonyChannels a Harmonizer takes the place of both, with an FFT
+// window sized by the latency tier, and renders its voices into that many
+// wet channels.
+//
+// With bandSplit the slot instead splits its input at a Linkwitz-Riley
+// crossover and owns two child slots: the lows go through a long-window
+// stretcher at a decimated rate (fine frequency resolution for low strings,
+// at a fraction of the FFT cost), the highs through a short-window one at
+// the full rate. Both children are read at the parent's delay, so the bands
+// recombine time-aligned.
+//
+// The slot is addressed on the engine's input timeline: input frame n of the
+// engine comes out as wet frame n, GetDelayFrames() later. Two slots built
+// with different settings can therefore run side by side and be crossfaded
+// sample-aligned while the engine hot-swaps between them.
+//
+// Construction allocates and may run on any thread; Write() and Read() are
+// allocation-free and belong to whichever thread currently owns the slot.
+class StretcherSlot
+{
+public:
+    StretcherSlot(double inSampleRate, uint32_t inNumInputChannels, uint32_t inMaxFramesPerBlock,
+                  const StretcherSettings& inSettings);
+    ~StretcherSlot();
+
+    // Drops all audio; the next written frame is timeline index inStartIndex.
+    // Allocation-free, so it can follow every transport relocate.
+    void Reset(int64_t inStartIndex);
+
+    // Cheap when unchanged; RubberBand picks the new scale up on its next hop
+    void SetPitchScale(double inPitchScale);
+
+    // Band split frequency; ignored without bandSplit
+    void SetCrossoverFrequency(double inFrequency);
+
+    // Harmony voices; ignored without harmonyChannels
+    void SetVoices(const HarmonyVoice* inVoices, uint32_t inNumVoices);
+
+    // Pitch of the input to the next Write(), from a detector the caller
+    // already runs, so a monophonic slot skips its own; ignored otherwise
+    void SetPitchEstimate(double inPeriodFrames, float inAperiodicity);
+
+    // Feeds engine input frames, starting at timeline index GetNextInputIndex().
+    // Any number of frames; larger writes are split internally. With a pool
+    // the two bands of a split slot, or the harmony voices, run in parallel;
+    // false when one missed the pool's deadline, after which the slot must
+    // be left alone until the pool is idle, then Reset().
+    bool Write(const float* const* inInputs, uint32_t inFrames, RenderWorkerPool* inPool = nullptr);
+
+    // Fills outWet (GetNumWetChannels() buffers) with the wet frames for
+    // timeline indices [inFirstIndex, inFirstIndex + inFrames). Frames not
+    // produced yet are zero; returns how many of those the stretcher owed
+    // (it stalled), as opposed to frames from before its first output.
+    uint32_t Read(float* const* outWet, int64_t inFirstIndex, uint32_t inFrames);
+
+    // Wet frames produced beyond the last Read(): the margin before a stall
+    uint32_t GetBufferedFrames() const;
+
+    const StretcherSettings& GetSettings() const { return mSettings; }
+    double GetSampleRate() const { return mSampleRate; }
+    uint32_t GetNumInputChannels() const { return mNumInputChannels; }
+    uint32_t GetMaxFramesPerBlock() const { return mMaxFramesPerBlock; }
+    uint32_t GetNumStretchChannels() const { return mNumStretchChannels; }
+    uint32_t GetNumWetChannels() const { return mNumWetChannels; }
+    uint32_t GetDelayFrames() const { return mDelayFrames; }
+    int64_t GetNextInputIndex() const { return mNextInputIndex; }
+
+    // Link for the engine's list of slots waiting to be freed, so retiring
+    // one never allocates
+    StretcherSlot* GetNextRetired() const { return mNextRetired; }
+    void SetNextRetired(StretcherSlot* inSlot) { mNextRetired = inSlot; }
+
+private:
+    // Sizes the FIFOs for the host block and mDelayFrames
+    void AllocateFifos();
+
+    // Raises the delay a child slot is read at to its parent's
+    void ExtendDelay(uint32_t inDelayFrames);
+
+    // Moves whatever the FIFOs allow through the stretcher
+    void PumpStretcher();
+
+    // Band split: feeds one chunk to both children, and runs one child's
+    // share (0 high, 1 low) as a RenderWorkerPool task; false as for Write()
+    bool WriteBands(const float* const* inChunk, int64_t inFirstIndex, uint32_t inFrames, RenderWorkerPool* inPool);
+    void WriteBand(uint32_t inBand);
+    static void WriteBandTask(void* inContext, uint32_t inBand);
+    uint32_t ReadBands(float* const* outWet, int64_t inFirstIndex, uint32_t inFrames);
+
+    // Queues wet output, dropping the start delay first
+    void WriteOutput(float* const* inData, uint32_t inFrames);
+
+    StretcherSettings mSettings;
+    const AudioKernels& mKernels;
+    double mSampleRate;
+    std::unique_ptr<RubberBand::RubberBandStretcher> mStretcher;  // Null in the live tier
+    GranularShifter mGranular;
+    PsolaShifter mPsola;
+    Harmonizer mHarmonizer;
+    uint32_t mNumInputChannels;
+    uint32_t mNumStretchChannels;
+    uint32_t mNumWetChannels;     // Stretched channels, or the harmony outputs
+    uint32_t mMaxFramesPerBlock;
+    uint32_t mStretchChunkFrames;
+    uint32_t mDelayFrames;
+    double mPitchScale;
+
+    // FIFOs between the engine and the stretcher
+    AudioFifo mInputFifo;
+    AudioFifo mOutputFifo;
+
+    // Preallocated scratch: one chunk for feeding/retrieving the stretcher
+    // (or for the granular shifter's or harmonizer's output), one host block
+    // of folded input
+    std::vector<float> mStretchBuffer;
+    std::vector<float> mFoldBuffer;
+    std::vector<float*> mStretchPtrs;
+    std::vector<const float*> mChunkPtrs;
+    std::vector<float*> mReadPtrs;
+
+    // Band split: the children, filters, and the chunk being written
+    std::unique_ptr<StretcherSlot> mHighBand;
+    std::unique_ptr<StretcherSlot> mLowBand;
+    LinkwitzRileyCrossover mCrossover;
+    ButterworthLowpass mUpsampler;
+    uint32_t mDecimation;              // Low band runs at 1/mDecimation of the rate
+    uint32_t mUpsampleDelayFrames;     // Group delay the upsampler adds to the lows
+    int64_t mUpsampleIndex;            // Next index the upsampler expects
+    uint32_t mBandFrames;
+    uint32_t mDecimatedFrames;
+    std::vector<float> mBandBuffer;          // Low band, then high band, one block each
+    std::vector<float> mDecimatedBuffer;
+    std::vector<float*> mLowPtrs;
+    std::vector<float*> mHighPtrs;
+    std::vector<float*> mDecimatedPtrs;
+
+    // Timeline bookkeeping
+    int64_t mNextInputIndex;      // Index of the next frame Write() receives
+    int64_t mOutputIndex;         // Index of the frame at the output FIFO's front
+    uint32_t mStartDelayToDrop;   // Start delay not yet discarded
+
+    StretcherSlot* mNextRetired;
+};
+
+#endif /* __StretcherSlot_h__ */